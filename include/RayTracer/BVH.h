@@ -1,17 +1,19 @@
 #pragma once
 
-#include <RayTracer/Triangle.h>
+#include <RayTracer/Mesh.h>
 #include <RayTracer/Ray.h>
 #include <vector>
+#include <cfloat>
+#include <atomic>
 
 // ĵ㣬м
 struct AABBTemp {
 	Eigen::Vector4f min;
 	Eigen::Vector4f max;
 	Eigen::Vector4f center;
-	int index;
 
-	AABBTemp(int index, const Eigen::Vector4f& min, const Eigen::Vector4f& max);
+	AABBTemp() {}
+	AABBTemp(const Eigen::Vector4f& min, const Eigen::Vector4f& max);
 };
 
 // մ洢ֻб߿
@@ -19,36 +21,119 @@ struct AABB {
 	Eigen::Vector4f min;
 	Eigen::Vector4f max;
 
+	// հΧ
+	AABB();
 	AABB(const Eigen::Vector4f& min, const Eigen::Vector4f& max);
-	bool hit(const Ray& r) const;
-};
-
-struct TreeNode {
-	AABB aabb;
-	std::unique_ptr<TreeNode> left;
-	std::unique_ptr<TreeNode> right;
-	int vertexIndex;
 
-	TreeNode(int vertexIndex, const Eigen::Vector4f& min, const Eigen::Vector4f& max);
+	void expand(const Eigen::Vector4f& pointMin, const Eigen::Vector4f& pointMax);
+	void expand(const AABB& rhs);
 };
 
 struct LinearNode {
 	AABB aabb;
 	int left;
 	int right;
-	int vertexIndex;
 
-	// ʼaabbindex
-	LinearNode(const TreeNode& treeNode);
+	// ҶڵбеķΧҶڵprimCountΪ0
+	int primStart;
+	int primCount;
+
+	LinearNode();
+};
+
+// ɶϲõNڵ㣬NΪ4ʱSSEΪ8ʱAVXһμӽڵ
+template <int N>
+struct alignas(32) WideNode {
+	// ӽڵΧУminX, minY, minZ, maxX, maxY, maxZд洢
+	float bounds[6][N];
+
+	// ӽڵΪڲڵʱǽڵ±꣬ΪҶڵʱǵһο±
+	int child[N];
+
+	// ҶڵοڲڵΪ0λΪ-1
+	int blockCount[N];
+};
+
+// ֻ󽻵ݣNһ鰴д洢һμN
+// vertexPosition(2)Ϊ㣬 = vertex + alpha * edge1 + beta * edge2
+template <int N>
+struct alignas(32) TriangleBlock {
+	float vertex[3][N];
+	float edge1[3][N];
+	float edge2[3][N];
+
+	// ڵе±꣬ղһĿλΪ-1
+	int meshIndex[N];
+	int triangleIndex[N];
+};
+
+// 
+enum class BVHBuilder {
+	Median,  // м仮֣ÿҶڵ
+	SAH      // Ͱıʽ֣ҶڵСɿ
+};
+
+// 㣬triangleIndexΪ-1ʱʾûཻ
+struct HitRecord {
+	float t;
+	float alpha;
+	float beta;
+	int meshIndex;
+	int triangleIndex;
 };
 
 class BVH {
 public:
-	void buildTree(const std::vector<Triangle>& triangles);
+	// widthΪʱʹõĽڵȣ48
+	void buildTree(const std::vector<Mesh>& meshes, BVHBuilder builder, int width);
 
-	// еεб
-	const std::vector<int>& hit(const Ray& r) const;
+	// ֱο󽻣tmaxڵ
+	HitRecord hit(const Ray& r, float tmax = FLT_MAX) const;
+
+	// ӰߵֻжϿɼԵĲѯ(rayEpsilon, tmax)μtrue
+	bool occluded(const Ray& r, float tmax) const;
+
+	// SAHԱһڵһεĿΪλ1
+	float sahCost() const;
+	// һνĺʱλΪ
+	float buildTime() const;
+	int nodeNum() const;
 
 private:
+	// ֻڽʹ
 	std::vector<LinearNode> linearTree;
+
+	// ʹõĿڵο飬ֻwidthӦһǿ
+	std::vector<WideNode<4>> wideTree4;
+	std::vector<WideNode<8>> wideTree8;
+	std::vector<TriangleBlock<4>> triangleBlocks4;
+	std::vector<TriangleBlock<8>> triangleBlocks8;
+	int width;
+
+	// Ҷڵõֻڽʹ
+	// ͳһţmeshTriangleOffset[i]Ϊiһεı
+	std::vector<int> primIndices;
+	std::vector<int> meshTriangleOffset;
+	float cost;
+	float buildSeconds;
+
+	// [start, end)ΧΣӽڵֱдlinearTreeTBBвй
+	void buildNode(const std::vector<AABBTemp>& primBounds, BVHBuilder builder, std::atomic<int>& nodeCount,
+				   int nodeIndex, int start, int end, int depth);
+
+	// ѶڵϲΪNӽڵ㣬дwideTree[wideIndex]Ҷڵδɿ
+	template <int N>
+	void collapseNode(const std::vector<Mesh>& meshes, std::vector<WideNode<N>>& wideTree,
+					  std::vector<TriangleBlock<N>>& triangleBlocks, int binaryIndex, int wideIndex) const;
+
+	template <int N>
+	HitRecord hitWide(const std::vector<WideNode<N>>& wideTree, const std::vector<TriangleBlock<N>>& triangleBlocks,
+					  const Ray& r, float tmax) const;
+
+	template <int N>
+	bool occludedWide(const std::vector<WideNode<N>>& wideTree, const std::vector<TriangleBlock<N>>& triangleBlocks,
+					  const Ray& r, float tmax) const;
+
+	// ͳһŶӦ±ڵ±
+	std::pair<int, int> locateTriangle(int primIndex) const;
 };
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string_view>
+
+// Ļ׼ԣȽϰкͷֿڼַģʽµĺʱ
+void textureBenchmark(std::string_view path);
\ No newline at end of file
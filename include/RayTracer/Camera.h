@@ -2,14 +2,14 @@
 
 #include "RayTracer/Ray.h"
 #include <Eigen/Core>
-#include <array>
 
 class Camera {
 public:
 	void setCamera(const Eigen::Vector4f& origin, const Eigen::Vector4f& viewPoint,
 				   float focal, float rotateAngle, int width, int height);
 
-	std::array<Ray, 4> getRay(int x, int y) const;
+	// ڵƫɲصĹߴصĲ
+	Ray getRay(int x, int y, float u, float v) const;
 
 private:
 	Eigen::Vector4f origin;
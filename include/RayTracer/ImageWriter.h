@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// ں̨̱߳벢дPNGPFMȾֻ߳踴һݻ
+// ֻһ֡ȴддʱµһ֡滻ûʼдľ֡
+class ImageWriter {
+public:
+	ImageWriter();
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter&) = delete;
+	ImageWriter& operator=(const ImageWriter&) = delete;
+
+	// pathչldrBufferΪ8λsRGBhdrBufferΪԵĸΪյһֲд
+	// ر滻֡·û滻ʱΪ
+	std::string submit(const std::string& path, const std::vector<uint8_t>& ldrBuffer,
+					   const std::vector<float>& hdrBuffer, int width, int height);
+
+	// ȴύ֡д
+	void finish();
+
+private:
+	struct Image {
+		std::string path;
+		std::vector<uint8_t> ldrBuffer;
+		std::vector<float> hdrBuffer;
+		int width;
+		int height;
+	};
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	Image pending;
+	bool hasPending = false;
+	bool writing = false;
+	bool stop = false;
+	std::thread worker;
+
+	void run();
+};
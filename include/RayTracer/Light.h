@@ -0,0 +1,40 @@
+#pragma once
+
+#include <RayTracer/Mesh.h>
+#include <RayTracer/Material.h>
+#include <Eigen/Core>
+#include <vector>
+
+// Դϵһ
+struct LightSample {
+	Eigen::Vector4f position;
+	Eigen::Vector4f normal;
+	Eigen::Vector4f emission;
+};
+
+// зΣ
+class LightList {
+public:
+	void build(const std::vector<Mesh>& meshes, const std::vector<Material>& materials);
+
+	bool hasLight() const;
+
+	// [0, 1)һѡΣȷϵĵ
+	LightSample sample(float u0, float u1, float u2) const;
+
+	// ѡκϾȲµĸܶȴͬ
+	float areaPdf() const;
+
+private:
+	struct LightTriangle {
+		Eigen::Vector4f vertex[3];
+		Eigen::Vector4f normal[3];
+		Eigen::Vector4f emission;
+	};
+
+	std::vector<LightTriangle> triangles;
+
+	// ۻֲ
+	std::vector<float> cdf;
+	float totalArea = 0.0f;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <RayTracer/Ray.h>
+#include <Eigen/Core>
+#include <utility>
+
+// һɢĽ
+struct ScatterSample {
+	// λȵĳ䷽
+	Eigen::Vector4f direction;
+
+	// BSDF * cos / pdf䷽ڱʱΪ0
+	Eigen::Vector4f weight;
+
+	// ǲµĸܶ
+	float pdf;
+};
+
+// ʱеһͬһģ͵ιһ
+class Material {
+public:
+	// [0, 1], ɫǽ淴ɫ
+	Eigen::Vector4f color;
+
+	// 淴ĴֲڶȣΪGGXalpha0Ϊ뾵
+	float specularRoughness;
+
+	// 
+	float refractiveIndex;
+
+	// ָʹõ
+	int textureIndex;
+
+	bool isLightEmitting;
+	bool isMetal;
+	bool isTransparent;
+
+	// ÿε[0, 1)һߣڴ
+	// ΪҷֲLambert淴ΪGGX΢ģ
+	ScatterSample diffuse(const Eigen::Vector4f& normal, const Ray& r, float u1, float u2) const;
+	ScatterSample specular(const Eigen::Vector4f& normal, const Ray& r, float u1, float u2) const;
+
+	// õdirectionĸܶȣǲȣ
+	float diffusePdf(const Eigen::Vector4f& normal, const Ray& r, const Eigen::Vector4f& direction) const;
+
+	// ԼռıȫʱΪ0Ϊ
+	std::pair<float, Eigen::Vector4f> refract(const Eigen::Vector4f& normal, const Ray& r) const;
+};
\ No newline at end of file
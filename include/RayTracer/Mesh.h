@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <cstdint>
+
+// 񣬶ݰ洢ͨ
+struct Mesh {
+	std::vector<Eigen::Vector4f> positions;
+
+	// 㷨ֵõνķ
+	std::vector<Eigen::Vector4f> normals;
+
+	// ӳUV꣬ûʱΪ
+	std::vector<Eigen::Vector2f> uvCoordinates;
+
+	// ÿһ
+	std::vector<uint32_t> indices;
+
+	// ڲʱе±
+	int materialIndex;
+
+	int triangleNum() const { return static_cast<int>(indices.size() / 3); }
+	const Eigen::Vector4f& position(int triangle, int k) const { return positions[indices[triangle * 3 + k]]; }
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// ʽ(, ֡, , ά)ɢеõ̵߳޹أȫ
+// ״ֻ̬мԷڼĴҲ԰ͨ
+// refer to: Hash Functions for GPU Rendering (Jarzynski & Olano 2020)
+class Random {
+public:
+	Random(uint32_t pixel, uint32_t frame) :
+		key(hash(pixel + hash(frame))), bounceKey(hash(key)), dimension(0) { }
+
+	// ·׷ÿηӵ0ά¿ʼݹ鷽ʽãάһֱ
+	void startBounce(uint32_t bounce) {
+		bounceKey = hash(key + hash(bounce));
+		dimension = 0;
+	}
+
+	// [0, 1)ľȷֲÿεʹһά
+	float next() {
+		return (hash(bounceKey + dimension++) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// PCGɢ
+	static uint32_t hash(uint32_t value) {
+		uint32_t state = value * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+private:
+	uint32_t key;
+	uint32_t bounceKey;
+	uint32_t dimension;
+};
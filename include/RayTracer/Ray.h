@@ -2,10 +2,20 @@
 
 #include <Eigen/Core>
 
+// ʱԵС룬ΪλʱΪռеľ룬ƽ汾ཻ
+constexpr float rayEpsilon = 0.001f;
+
 struct Ray {
 	Eigen::Vector4f origin;
 	Eigen::Vector4f direction;
 
+	// صĹڱߵĲ֣ڹĲΧ
+	Eigen::Vector4f originDx;
+	Eigen::Vector4f originDy;
+	Eigen::Vector4f directionDx;
+	Eigen::Vector4f directionDy;
+	bool hasDifferentials = false;
+
 	Ray() {}
 	Ray(const Eigen::Vector4f& origin, const Eigen::Vector4f& direction) :
 		origin(origin), direction(direction) { }
@@ -1,13 +1,34 @@
 #pragma once
 
-#include <RayTracer/Triangle.h>
+#include <RayTracer/Mesh.h>
+#include <RayTracer/Material.h>
 #include <RayTracer/Camera.h>
 #include <RayTracer/BVH.h>
 #include <RayTracer/Texture.h>
+#include <RayTracer/TextureCache.h>
 #include <RayTracer/Skybox.h>
+#include <RayTracer/Light.h>
+#include <RayTracer/Sampler.h>
+#include <RayTracer/ImageWriter.h>
 #include <Eigen/Core>
 #include <string_view>
 #include <optional>
+#include <memory>
+#include <unordered_map>
+#include <string>
+
+// ɫķʽ
+enum class Integrator {
+	Recursive,  // ÿη߲ݹ
+	Path        // ÿηֻһ·ö˹̶Ľ
+};
+
+// ͼʽPFMΪԵĸ
+enum class OutputFormat {
+	PNG,
+	PFM,
+	Both
+};
 
 class RayTracer {
 public:
@@ -18,16 +39,57 @@ private:
 	int height;
 	int renderNum;
 	Eigen::Array<Eigen::Vector4f, -1, -1, Eigen::RowMajor> accumulateImg;
+	// ÿ֡ȵƽԼۻ֡ڹƷ
+	Eigen::Array<float, -1, -1, Eigen::RowMajor> accumulateSquare;
+	Eigen::Array<int, -1, -1, Eigen::RowMajor> frameCount;
 	std::vector<uint8_t> outputBuffer;
-	std::vector<Triangle> trianglesArray;
+	std::vector<float> hdrBuffer;
+	ImageWriter imageWriter;
+	std::vector<Mesh> meshesArray;
+	std::vector<Material> materialsArray;
 	std::vector<Texture> texturesArray;
+	// 淶·ļݵĹϣȥأģͬһͼʱһ±
+	std::unordered_map<std::string, int> texturePaths;
+	std::unordered_multimap<uint64_t, int> textureHashes;
 	Camera camera;
 	BVH bvh;
+	BVHBuilder bvhBuilder = BVHBuilder::SAH;
+	int bvhWidth = 8;
 	Skybox skybox;
+	LightList lights;
 
 	int diffuseRayNum;
 	int specualrRayNum;
 	int maxRecursionDepth;
+	Integrator integrator = Integrator::Recursive;
+	bool lightSampling = true;
+	SamplerType samplerType = SamplerType::Sobol;
+
+	// 水ͼ黮֣Morton˳
+	struct Tile {
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+	int tileSize = 16;
+
+	// ӦֵΪ0ʱÿ֡ز
+	float noiseThreshold = 0.0f;
+
+	// ȾʱԤ㣬λΪ룬Ϊ0ʱrender_numȾ
+	float timeBudget = 0.0f;
+
+	// ÿ֡һΣΪ0ʱֻһ֡
+	int outputInterval = 1;
+	OutputFormat outputFormat = OutputFormat::PNG;
+	TextureOptions textureOptions;
+	// ڴޣλΪMBΪ0ʱȫڴ
+	int textureCacheMB = 0;
+	std::unique_ptr<TextureCache> textureCache;
+	std::vector<Tile> tiles;
+	// һ֡ͼĺʱλΪ
+	std::vector<float> tileSeconds;
 	Eigen::Vector4f backgroundColor;
 
 	void setCamera(float cameraX, float cameraY, float cameraZ,
@@ -45,6 +107,9 @@ private:
 				   const std::optional<std::string_view>& texturePath,
 				   const std::optional<Eigen::Vector4f>& color);
 
+	// texturesArrayе±꣬޷ȡʱ-1
+	int loadTexture(std::string_view path);
+
 	void addTriangle(const Eigen::Vector4f& vertex0,
 					 const Eigen::Vector4f& vertex1,
 					 const Eigen::Vector4f& vertex2,
@@ -53,6 +118,41 @@ private:
 					 bool isMetal, bool isLightEmitting, bool isTransparent,
 					 float specularRoughness, float refractiveIndex);
 
+	// 볡㴦ɫϢ
+	struct HitInfo {
+		Eigen::Vector4f hitPoint;
+		Eigen::Vector4f normal;
+		Eigen::Vector2f uvCoordinate;
+		const Material* material;
+
+		// ߴвʱλáUVɫ߶صĲ֣Ϊ
+		Eigen::Vector4f positionDx;
+		Eigen::Vector4f positionDy;
+		Eigen::Vector2f uvDx;
+		Eigen::Vector2f uvDy;
+		Eigen::Vector4f normalDx;
+		Eigen::Vector4f normalDy;
+	};
+
+	// ¹ߵɢ䷽ʽδ
+	enum class ScatterType {
+		Reflect,  // GGX
+		Refract,  // ͸ʵ
+		Diffuse   // 䣬ȡ̶Ž
+	};
+
+	void buildTiles();
+	bool converged(int row, int col) const;
+	// ظر֡Ƿ˲سڸֱ֡
+	bool renderPixel(int row, int col, int frame);
+	// ۻתΪͼldrΪgammaУ8λͼhdrΪԵĸͼ
+	void resolveOutput(bool ldr, bool hdr);
 	void render();
-	Eigen::Vector4f color(int depth, const Ray& r) const;
+	std::optional<HitInfo> intersect(const Ray& r) const;
+	Eigen::Vector4f background(const Ray& r) const;
+	Eigen::Vector4f sampleTexture(const HitInfo& hit) const;
+	// ӽµĹߣ·
+	Ray spawnRay(const Ray& r, const HitInfo& hit, const Eigen::Vector4f& direction, ScatterType type) const;
+	Eigen::Vector4f color(int depth, const Ray& r, Sampler& sampler) const;
+	Eigen::Vector4f pathColor(const Ray& cameraRay, Sampler& sampler) const;
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <RayTracer/Random.h>
+#include <cstdint>
+
+enum class SamplerType {
+	Independent,  // ÿһάɢ
+	Sobol,        // OwenҵSobolУÿʹòͬ
+	BlueNoise     // عͬһҵSobolУƽƣĻϳֲ
+};
+
+// ΪһṩάȵĲֵ
+// ǰάڵƫƣ֮󰴷άȡֵRandom÷ͬ
+class Sampler {
+public:
+	// sampleIndexΪصĵڼ֮֡
+	Sampler(SamplerType type, int x, int y, int width, uint32_t sampleIndex);
+
+	// ·׷ÿηӵ0ά¿ʼݹ鷽ʽãάһֱ
+	void startBounce(uint32_t bounce);
+
+	// [0, 1)֮Ĳֵÿεʹһά
+	float next();
+
+private:
+	SamplerType type;
+	int x;
+	int y;
+	uint32_t sampleIndex;
+	uint32_t pixelSeed;
+	uint32_t bounce;
+	uint32_t dimension;
+
+	// Sobolάһɣڶά´ε
+	float pairSecond;
+
+	Random random;
+
+	float sobolPair(uint32_t pairIndex);
+};
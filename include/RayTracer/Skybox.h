@@ -17,6 +17,7 @@ public:
 			  std::string_view bottomPath);
 
 	bool hasSkybox() const;
+	void prepare(const TextureOptions& options, TextureCache* cache);
 	Eigen::Vector4f sampleBackground(const Ray& ray) const;
 
 private:
@@ -2,21 +2,93 @@
 
 #include <Eigen/Core>
 #include <string_view>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+enum class TextureFilter {
+	Nearest,    // ߷ֱʵĲȡ
+	Bilinear,   // Χѡһ㣬˫Բֵ
+	Trilinear   // ˫Բֵ֮ٲֵ
+};
+
+// ڴеĸʽתԿռԲת
+enum class TextureStorage {
+	Float,  // Եĸȸߣռ4ڴ
+	Byte    // ԭʼ8λsRGBʱ256ıתΪ
+};
+
+// ڴезʽ
+enum class TextureLayout {
+	Linear,  // 
+	Tiled    // 8x8ĿУڰУڵĲͬһкڴҳ
+};
+
+// Ⱦǰͳһõѡ
+struct TextureOptions {
+	TextureFilter filter = TextureFilter::Trilinear;
+	TextureStorage storage = TextureStorage::Byte;
+	TextureLayout layout = TextureLayout::Linear;
+};
+
+class TextureCache;
 
 // assume it's RGB
 class Texture {
 public:
+	// ֻȡͼƬĴСȾǰٽ
 	Texture(std::string_view path);
-	~Texture();
-	Texture(Texture&& rhs) noexcept;
-	Texture& operator=(Texture&& rhs) noexcept;
 
 	bool hasTexture() const;
+	const std::string& filePath() const;
+
+	// Ⱦǰ룬ѡmipmapתʽзʽֻ֮ܲܵһ
+	// cacheΪʱÿɺ󼴰д뻺ʱļڴв
+	void prepare(const TextureOptions& options, TextureCache* cache = nullptr);
+
+	// ʹûʱÿֽɴ洢ʽ
+	static size_t cacheTileBytes(TextureStorage storage);
+
+	// ûвʱ߷ֱʵĲϲ
 	Eigen::Vector4f sampleTexture(const Eigen::Vector2f& uvCoordinate) const;
 
+	// uvDxuvDyΪ֮UVı仯ʹһ
+	Eigen::Vector4f sampleTexture(const Eigen::Vector2f& uvCoordinate,
+								  const Eigen::Vector2f& uvDx, const Eigen::Vector2f& uvDy) const;
+
 private:
-	uint8_t* data;
-	float uMaxIndex;
-	float vMaxIndex;
-	int width;
+	// mipmapһ㣬0Ϊԭͼÿ㳤룬storageֻһݷǿ
+	struct MipLevel {
+		std::vector<uint8_t> bytes;
+		std::vector<float> floats;
+		int width;
+		int height;
+		// ֿлʹûʱÿеĿ
+		int tileNumX;
+		// ʹûʱһļеı
+		uint32_t tileBase;
+	};
+	std::string path;
+	bool valid;
+	std::vector<MipLevel> levels;
+	TextureOptions options;
+	TextureCache* cache = nullptr;
+	int cacheFile = -1;
+
+	// һ㰴64x64Ŀ׷ӵļͷڴеݣдĿ
+	uint32_t spillLevel(MipLevel& level) const;
+
+	// صĵһе±
+	int texelOffset(const MipLevel& level, int x, int y) const;
+
+	// ʹûʱһβеĿ飬ͬһʱٲһ
+	struct TileRef {
+		uint32_t index = UINT32_MAX;
+		std::shared_ptr<const std::vector<uint8_t>> data;
+	};
+
+	Eigen::Vector4f texel(const MipLevel& level, int x, int y, TileRef& tile) const;
+	Eigen::Vector4f nearest(const Eigen::Vector2f& uvCoordinate) const;
+	Eigen::Vector4f bilinear(int levelIndex, const Eigen::Vector2f& uvCoordinate) const;
 };
\ No newline at end of file
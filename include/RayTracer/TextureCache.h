@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// ֿĻ棬תֿдʱļʱ룬ڴ治
+// ֳֵɶƬÿƬԼLRUTBB߳̿Բ
+class TextureCache {
+public:
+	// пĴСΪtileBytesҪһ
+	TextureCache(size_t budgetBytes, size_t tileBytes);
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	// ½һʱļļ
+	int create();
+
+	// Ѱе׷ӵļĩβıŽдĿ
+	void append(int file, const std::vector<uint8_t>& tiles);
+
+	// ȡļеһ飬ڻʱļȡصĿʹڼ䲻ᱻͷ
+	std::shared_ptr<const std::vector<uint8_t>> tile(int file, uint32_t tileIndex);
+
+	struct Counters {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t residentBytes;
+	};
+
+	// ϴεļ
+	Counters takeCounters();
+
+private:
+	// ƬɵĿʹÿƬܷһ飬ڴ治ΪÿƬһ
+	static constexpr int maxShardNum = 64;
+
+	struct Entry {
+		std::shared_ptr<const std::vector<uint8_t>> data;
+		std::list<uint64_t>::iterator position;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		// ʹõǰ
+		std::list<uint64_t> lru;
+		std::unordered_map<uint64_t, Entry> entries;
+		size_t bytes = 0;
+	};
+
+	// ƫƶȡƶļλã߳̿ͬʱͬһļ
+	// ļΨһֶռ󼴱ɾ˳ʱϵͳ
+	struct File {
+		// WindowsΪHANDLEƽ̨Ϊļ
+		intptr_t handle;
+		uint64_t size;
+	};
+
+	size_t tileBytes;
+	size_t shardBudget;
+	std::vector<Shard> shards;
+	std::vector<File> files;
+	std::atomic<uint64_t> hits = 0;
+	std::atomic<uint64_t> misses = 0;
+	std::atomic<uint64_t> evictions = 0;
+	std::atomic<size_t> residentBytes = 0;
+
+	std::shared_ptr<const std::vector<uint8_t>> load(int file, uint32_t tileIndex);
+};
\ No newline at end of file
@@ -1,44 +0,0 @@
-#pragma once
-
-#include <RayTracer/Ray.h>
-#include <Eigen/Core>
-
-class Triangle {
-public:
-	Eigen::Array<Eigen::Vector4f, 3, 1> vertexPosition;
-
-	// 㷨ֵõνķ
-	Eigen::Array<Eigen::Vector4f, 3, 1> vertexNormal;
-
-	// ƽ淨Ƿཻ
-	Eigen::Vector4f planeNormal;
-
-	// [0, 1], ɫǽ淴ɫ
-	Eigen::Vector4f color;
-
-	// ӳUV
-	Eigen::Array<Eigen::Vector2f, 3, 1> uvCoordinate;
-
-	// 淴Ĺ⻬
-	float specularRoughness;
-
-	// 
-	float refractiveIndex;
-
-	// ָʹõ
-	int textureIndex;
-
-	bool isLightEmitting;
-	bool isMetal;
-	bool isTransparent;
-
-	// return [alpha, beta, t]
-	Eigen::Vector4f hit(const Ray& r) const;
-
-	// ض
-	std::vector<Eigen::Vector4f> diffuse(const Eigen::Vector4f& normal, const Ray& r, int diffuseRayNum) const;
-	std::vector<Eigen::Vector4f> specular(const Eigen::Vector4f& normal, const Ray& r, int specularRayNum) const;
-
-	// Լռı
-	std::pair<float, Eigen::Vector4f> refract(const Eigen::Vector4f& normal, const Ray& r) const;
-};
\ No newline at end of file
@@ -1,97 +1,221 @@
 #include <RayTracer/BVH.h>
 #include <algorithm>
-#include <stack>
+#include <numeric>
 #include <cfloat>
-#include <memory>
 #include <array>
+#include <chrono>
+#include <tbb/tbb.h>
 
-AABBTemp::AABBTemp(int index, const Eigen::Vector4f& min, const Eigen::Vector4f& max) :
-	min(min), max(max), center((min + max) * 0.5f), index(index) {
+AABBTemp::AABBTemp(const Eigen::Vector4f& min, const Eigen::Vector4f& max) :
+	min(min), max(max), center((min + max) * 0.5f) {
 }
 
-AABB::AABB(const Eigen::Vector4f& min, const Eigen::Vector4f& max) : min(min), max(max) {}
+AABB::AABB() : min(Eigen::Vector4f::Constant(FLT_MAX)), max(Eigen::Vector4f::Constant(-FLT_MAX)) {}
 
-bool AABB::hit(const Ray& r) const {
-	Eigen::Vector4f invD = r.direction.cwiseInverse();
-	Eigen::Vector4f t0v = (min - r.origin).cwiseProduct(invD);
-	Eigen::Vector4f t1v = (max - r.origin).cwiseProduct(invD);
-
-	// if (invD[i] < 0) swap (t0v[i], t1v[i])
-	auto temp1 = _mm_load_ps(t0v.data());
-	auto temp2 = _mm_load_ps(t1v.data());
-	auto mask = _mm_load_ps(invD.data());
-	auto t0out = _mm_blendv_ps(temp1, temp2, mask);
-	auto t1out = _mm_blendv_ps(temp2, temp1, mask);
-
-	// 󽻼
-	float tmin = t0out.m128_f32[0];
-	float tmax = t1out.m128_f32[0];
-	for (int i = 1; i < 3; i++) {
-		float t0 = t0out.m128_f32[i];
-		float t1 = t1out.m128_f32[i];
-		tmin = t0 > tmin ? t0 : tmin;
-		tmax = t1 < tmax ? t1 : tmax;
-
-	}
-	// ƽƽtmax = tmin
-	if (tmax < tmin)
-		return false;
-	else
-		return true;
-}
+AABB::AABB(const Eigen::Vector4f& min, const Eigen::Vector4f& max) : min(min), max(max) {}
 
-TreeNode::TreeNode(int index, const Eigen::Vector4f& min, const Eigen::Vector4f& max) :
-	vertexIndex(index), aabb(min, max) {
+void AABB::expand(const Eigen::Vector4f& pointMin, const Eigen::Vector4f& pointMax) {
+	min = min.cwiseMin(pointMin);
+	max = max.cwiseMax(pointMax);
 }
 
-LinearNode::LinearNode(const TreeNode& treeNode) :
-	vertexIndex(treeNode.vertexIndex), aabb(treeNode.aabb), left(-1), right(-1) {
+void AABB::expand(const AABB& rhs) {
+	expand(rhs.min, rhs.max);
 }
 
-void BVH::buildTree(const std::vector<Triangle>& triangles) {
-	// İΧ
-	Eigen::Vector4f min = Eigen::Vector4f::Constant(FLT_MAX);
-	Eigen::Vector4f max = Eigen::Vector4f::Constant(-FLT_MAX);
+// SAHֵͰ
+constexpr int binNum = 16;
+// SAHҶڵɵ
+constexpr int maxLeafSize = 8;
+// һڵһεԿ
+constexpr float traversalCost = 1.0f;
+constexpr float intersectCost = 1.0f;
+// ֤ʱ64ջ
+constexpr int maxDepth = 64;
+// ķΧΧСͰͻֶڷΧڲ
+constexpr int parallelThreshold = 1 << 14;
+// ķΧΪTBBй
+constexpr int taskThreshold = 1 << 10;
 
-	std::vector<std::unique_ptr<AABBTemp>> leafList(triangles.size());
-	for (int i = 0; i < triangles.size(); ++i) {
-		// һεİΧ
-		Eigen::Vector4f tempMin = Eigen::Vector4f::Constant(FLT_MAX);
-		Eigen::Vector4f tempMax = Eigen::Vector4f::Constant(-FLT_MAX);
+static float surfaceArea(const Eigen::Vector4f& min, const Eigen::Vector4f& max) {
+	Eigen::Vector4f diff = max - min;
+	return 2.0f * (diff(0) * diff(1) + diff(1) * diff(2) + diff(2) * diff(0));
+}
 
-		const auto& vertex = triangles[i].vertexPosition;
-		for (int j = 0; j < 3; ++j) {
-			tempMin = tempMin.cwiseMin(vertex(j));
-			tempMax = tempMax.cwiseMax(vertex(j));
-			min = min.cwiseMin(vertex(j));
-			max = max.cwiseMax(vertex(j));
+// ԷΧÿεexpandFunc(aabb, triangleIndex)ϲİΧ
+template <typename Func>
+static AABB reduceBounds(const std::vector<int>& indices, int start, int end, Func expandFunc) {
+	if (end - start < parallelThreshold) {
+		AABB result;
+		for (int i = start; i < end; ++i) {
+			expandFunc(result, indices[i]);
 		}
+		return result;
+	}
+	return tbb::parallel_reduce(tbb::blocked_range<int>(start, end), AABB(),
+								[&](const tbb::blocked_range<int>& range, AABB result) {
+									for (int i = range.begin(); i < range.end(); ++i) {
+										expandFunc(result, indices[i]);
+									}
+									return result;
+								},
+								[](AABB lhs, const AABB& rhs) {
+									lhs.expand(rhs);
+									return lhs;
+								});
+}
+
+// ϸԷͰͳ
+struct BinSet {
+	std::array<std::array<int, binNum>, 3> count;
+	std::array<std::array<AABB, binNum>, 3> bounds;
 
-		leafList[i] = std::make_unique<AABBTemp>(i, tempMin, tempMax);
+	BinSet() {
+		for (auto& axisCount : count)
+			axisCount.fill(0);
 	}
 
-	// 
-	auto root = std::make_unique<TreeNode>(-1, min, max);
-	std::stack<std::tuple<TreeNode*, int, int>> s;
-	s.push(std::make_tuple(root.get(), 0, static_cast<int>(triangles.size())));
-	do {
-		auto [node, start, end] = s.top();
-		s.pop();
-		if (end - start <= 2) {
-			// һֻʣڵʱȻһڵ㣬ҵ
-			const auto& tempAABB = leafList[start];
-			node->left = std::make_unique<TreeNode>(tempAABB->index, tempAABB->min, tempAABB->max);
-
-			// ܴڵڶڵ㣬ҵ
-			if (end - start == 2) {
-				const auto& tempAABB2 = leafList[start + 1];
-				node->right = std::make_unique<TreeNode>(tempAABB2->index, tempAABB2->min, tempAABB2->max);
+	void merge(const BinSet& rhs) {
+		for (int axis = 0; axis < 3; ++axis) {
+			for (int i = 0; i < binNum; ++i) {
+				count[axis][i] += rhs.count[axis][i];
+				bounds[axis][i].expand(rhs.bounds[axis][i]);
 			}
 		}
-		else {
+	}
+};
+
+// ĵ϶ӦͰscaleΪ0ȫڵһͰ
+static int binIndex(const Eigen::Vector4f& center, const Eigen::Vector4f& centerMin, const Eigen::Vector4f& scale, int axis) {
+	return std::min(binNum - 1, static_cast<int>((center(axis) - centerMin(axis)) * scale(axis)));
+}
+
+// ƵΧǰػλ
+template <typename Pred>
+static int partitionRange(std::vector<int>& indices, int start, int end, Pred pred) {
+	if (end - start < parallelThreshold)
+		return static_cast<int>(std::partition(indices.begin() + start, indices.begin() + end, pred) - indices.begin());
+
+	// ֿԻٰ֣ǰ׺Ͱְᵽʱ
+	constexpr int chunkSize = parallelThreshold / 4;
+	int chunkNum = (end - start + chunkSize - 1) / chunkSize;
+	std::vector<int> chunkLeftCount(chunkNum);
+	tbb::parallel_for(0, chunkNum, [&](int chunk) {
+		auto chunkBegin = indices.begin() + start + chunk * chunkSize;
+		auto chunkEnd = indices.begin() + std::min(end, start + (chunk + 1) * chunkSize);
+		chunkLeftCount[chunk] = static_cast<int>(std::partition(chunkBegin, chunkEnd, pred) - chunkBegin);
+	});
+
+	std::vector<int> leftOffset(chunkNum), rightOffset(chunkNum);
+	int leftTotal = 0;
+	int rightTotal = 0;
+	for (int chunk = 0; chunk < chunkNum; ++chunk) {
+		int chunkCount = std::min(end, start + (chunk + 1) * chunkSize) - (start + chunk * chunkSize);
+		leftOffset[chunk] = leftTotal;
+		rightOffset[chunk] = rightTotal;
+		leftTotal += chunkLeftCount[chunk];
+		rightTotal += chunkCount - chunkLeftCount[chunk];
+	}
+
+	std::vector<int> temp(end - start);
+	tbb::parallel_for(0, chunkNum, [&](int chunk) {
+		auto chunkBegin = indices.begin() + start + chunk * chunkSize;
+		auto chunkMiddle = chunkBegin + chunkLeftCount[chunk];
+		auto chunkEnd = indices.begin() + std::min(end, start + (chunk + 1) * chunkSize);
+		std::copy(chunkBegin, chunkMiddle, temp.begin() + leftOffset[chunk]);
+		std::copy(chunkMiddle, chunkEnd, temp.begin() + leftTotal + rightOffset[chunk]);
+	});
+	tbb::parallel_for(0, chunkNum, [&](int chunk) {
+		auto chunkBegin = temp.begin() + chunk * chunkSize;
+		auto chunkEnd = temp.begin() + std::min(end - start, (chunk + 1) * chunkSize);
+		std::copy(chunkBegin, chunkEnd, indices.begin() + start + chunk * chunkSize);
+	});
+	return start + leftTotal;
+}
+
+LinearNode::LinearNode() : left(-1), right(-1), primStart(0), primCount(0) {}
+
+void BVH::buildTree(const std::vector<Mesh>& meshes, BVHBuilder builder, int width) {
+	auto time1 = std::chrono::system_clock::now();
+
+	meshTriangleOffset.resize(meshes.size() + 1);
+	meshTriangleOffset[0] = 0;
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		meshTriangleOffset[i + 1] = meshTriangleOffset[i] + meshes[i].triangleNum();
+	}
+
+	// ÿεİΧУͳһŴ洢ʱֻ
+	int triangleNum = meshTriangleOffset.back();
+	std::vector<AABBTemp> primBounds(triangleNum);
+	tbb::parallel_for(0, triangleNum, [&](int i) {
+		auto [meshIndex, triangleIndex] = locateTriangle(i);
+		const auto& mesh = meshes[meshIndex];
+		const auto& v0 = mesh.position(triangleIndex, 0);
+		const auto& v1 = mesh.position(triangleIndex, 1);
+		const auto& v2 = mesh.position(triangleIndex, 2);
+		primBounds[i] = AABBTemp(v0.cwiseMin(v1).cwiseMin(v2), v0.cwiseMax(v1).cwiseMax(v2));
+	});
+	primIndices.resize(triangleNum);
+	std::iota(primIndices.begin(), primIndices.end(), 0);
+
+	// ÿҶڵһΣĽڵ2n-1Ԥȷ
+	// ӽڵɶԷ䣬ӽڵ
+	linearTree.clear();
+	linearTree.resize(std::max(1, 2 * triangleNum - 1));
+	std::atomic<int> nodeCount(1);
+	linearTree[0].aabb = reduceBounds(primIndices, 0, triangleNum,
+									  [&](AABB& aabb, int index) { aabb.expand(primBounds[index].min, primBounds[index].max); });
+	buildNode(primBounds, builder, nodeCount, 0, 0, triangleNum, 0);
+	linearTree.resize(nodeCount);
+	linearTree.shrink_to_fit();
+
+	// ͳSAH
+	float rootArea = surfaceArea(linearTree[0].aabb.min, linearTree[0].aabb.max);
+	cost = 0.0f;
+	for (const auto& node : linearTree) {
+		float areaRatio = rootArea > 0.0f ? surfaceArea(node.aabb.min, node.aabb.max) / rootArea : 1.0f;
+		if (node.primCount > 0)
+			cost += intersectCost * node.primCount * areaRatio;
+		else
+			cost += traversalCost * areaRatio;
+	}
+
+	// ϲɿڵ㲢ο飬Ҫ
+	this->width = width;
+	wideTree4.clear();
+	wideTree8.clear();
+	triangleBlocks4.clear();
+	triangleBlocks8.clear();
+	if (width == 4) {
+		wideTree4.emplace_back();
+		collapseNode(meshes, wideTree4, triangleBlocks4, 0, 0);
+	}
+	else {
+		wideTree8.emplace_back();
+		collapseNode(meshes, wideTree8, triangleBlocks8, 0, 0);
+	}
+	std::vector<LinearNode>().swap(linearTree);
+	std::vector<int>().swap(primIndices);
+
+	auto time2 = std::chrono::system_clock::now();
+	buildSeconds = std::chrono::duration<float>(time2 - time1).count();
+}
+
+void BVH::buildNode(const std::vector<AABBTemp>& primBounds, BVHBuilder builder, std::atomic<int>& nodeCount,
+					int nodeIndex, int start, int end, int depth) {
+	auto& node = linearTree[nodeIndex];
+	int count = end - start;
+
+	// ֵ㣬С0ʱýڵΪҶڵ
+	int splitStart = -1;
+	// SAHͰʱ˳õӽڵİΧ
+	bool hasChildBounds = false;
+	AABB leftBounds, rightBounds;
+
+	if (builder == BVHBuilder::Median) {
+		if (count > 2 && depth + 1 < maxDepth) {
 			// ÿһλ֣ѡΧ
-			const auto& aabb = node->aabb;
-			Eigen::Vector4f diff = aabb.max - aabb.min;
+			Eigen::Vector4f diff = node.aabb.max - node.aabb.min;
 			float axisLength = diff(0);
 			int selectedAxis = 0;
 			for (int i = 1; i < 3; ++i) {
@@ -101,92 +225,503 @@ void BVH::buildTree(const std::vector<Triangle>& triangles) {
 				}
 			}
 
-			// ڵ㰴λѡϵ˳
-			std::sort(leafList.begin() + start, leafList.begin() + end,
-					  [selectedAxis](const auto& lhs, const auto& rhs) {
-						  return lhs->center(selectedAxis) < rhs->center(selectedAxis);
-					  });
-
-			// ٽĽڵ԰֣Ϊ
-			int splitStart = (start + end + 1) / 2;
-
-			// ҵǰһֵİΧ
-			min = Eigen::Vector4f::Constant(FLT_MAX);
-			max = Eigen::Vector4f::Constant(-FLT_MAX);
-			for (int i = start; i < splitStart; ++i) {
-				int vertexIndex = leafList[i]->index;
-				const auto& vertex = triangles[vertexIndex].vertexPosition;
-				for (int j = 0; j < 3; ++j) {
-					min = min.cwiseMin(vertex(j));
-					max = max.cwiseMax(vertex(j));
+			// λѡϵ˳԰ֻ֣Ҫҵλ
+			splitStart = (start + end + 1) / 2;
+			auto compare = [&primBounds, selectedAxis](int lhs, int rhs) {
+				return primBounds[lhs].center(selectedAxis) < primBounds[rhs].center(selectedAxis);
+			};
+			if (count < parallelThreshold)
+				std::nth_element(primIndices.begin() + start, primIndices.begin() + splitStart, primIndices.begin() + end, compare);
+			else
+				tbb::parallel_sort(primIndices.begin() + start, primIndices.begin() + end, compare);
+		}
+	}
+	else if (count > 1 && depth + 1 < maxDepth) {
+		// ĵİΧУͰķΧ
+		AABB centerBounds = reduceBounds(primIndices, start, end,
+										 [&](AABB& aabb, int index) { aabb.expand(primBounds[index].center, primBounds[index].center); });
+		const Eigen::Vector4f& centerMin = centerBounds.min;
+		Eigen::Vector4f extent = centerBounds.max - centerBounds.min;
+		Eigen::Vector4f scale;
+		for (int axis = 0; axis < 4; ++axis) {
+			scale(axis) = extent(axis) > 0.0f ? binNum / extent(axis) : 0.0f;
+		}
+
+		// ͳÿͰͰΧ
+		auto addToBins = [&](BinSet& bins, int begin, int end) {
+			for (int i = begin; i < end; ++i) {
+				const auto& temp = primBounds[primIndices[i]];
+				for (int axis = 0; axis < 3; ++axis) {
+					int bin = binIndex(temp.center, centerMin, scale, axis);
+					bins.count[axis][bin]++;
+					bins.bounds[axis][bin].expand(temp.min, temp.max);
+				}
+			}
+		};
+		BinSet bins;
+		if (count < parallelThreshold)
+			addToBins(bins, start, end);
+		else {
+			bins = tbb::parallel_reduce(tbb::blocked_range<int>(start, end), BinSet(),
+										[&](const tbb::blocked_range<int>& range, BinSet result) {
+											addToBins(result, range.begin(), range.end());
+											return result;
+										},
+										[](BinSet lhs, const BinSet& rhs) {
+											lhs.merge(rhs);
+											return lhs;
+										});
+		}
+
+		// ˽ڵıʡȥҲ˱Ϊ0
+		float nodeArea = surfaceArea(node.aabb.min, node.aabb.max);
+		float leafCost = intersectCost * count * nodeArea;
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestBin = -1;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (scale(axis) == 0.0f)
+				continue;
+
+			// ۻõÿλҲİΧ
+			std::array<AABB, binNum> rightAcc;
+			std::array<int, binNum> rightCount;
+			AABB acc;
+			int accCount = 0;
+			for (int i = binNum - 1; i > 0; --i) {
+				acc.expand(bins.bounds[axis][i]);
+				accCount += bins.count[axis][i];
+				rightAcc[i] = acc;
+				rightCount[i] = accCount;
+			}
+
+			// ۻڵiͰ֮ǰ
+			acc = AABB();
+			accCount = 0;
+			for (int i = 1; i < binNum; ++i) {
+				acc.expand(bins.bounds[axis][i - 1]);
+				accCount += bins.count[axis][i - 1];
+				if (accCount == 0 || accCount == count)
+					continue;
+
+				float splitCost = traversalCost * nodeArea +
+					intersectCost * (surfaceArea(acc.min, acc.max) * accCount +
+									 surfaceArea(rightAcc[i].min, rightAcc[i].max) * rightCount[i]);
+				if (splitCost < bestCost) {
+					bestCost = splitCost;
+					bestAxis = axis;
+					bestBin = i;
+					leftBounds = acc;
+					rightBounds = rightAcc[i];
+				}
+			}
+		}
+
+		if (bestAxis >= 0 && (bestCost < leafCost || count > maxLeafSize)) {
+			// Ͱλû
+			splitStart = partitionRange(primIndices, start, end, [&](int index) {
+				return binIndex(primBounds[index].center, centerMin, scale, bestAxis) < bestBin;
+			});
+			hasChildBounds = true;
+		}
+		else if (count > maxLeafSize) {
+			// ĵȫغϣ޷ͰֱӶ԰
+			splitStart = (start + end + 1) / 2;
+		}
+	}
+
+	if (splitStart < 0) {
+		node.primStart = start;
+		node.primCount = count;
+		return;
+	}
+
+	// ҵֵİΧ
+	if (!hasChildBounds) {
+		auto expandFunc = [&](AABB& aabb, int index) { aabb.expand(primBounds[index].min, primBounds[index].max); };
+		leftBounds = reduceBounds(primIndices, start, splitStart, expandFunc);
+		rightBounds = reduceBounds(primIndices, splitStart, end, expandFunc);
+	}
+
+	int leftIndex = nodeCount.fetch_add(2);
+	node.left = leftIndex;
+	node.right = leftIndex + 1;
+	linearTree[leftIndex].aabb = leftBounds;
+	linearTree[leftIndex + 1].aabb = rightBounds;
+
+	auto buildLeft = [&]() {
+		buildNode(primBounds, builder, nodeCount, leftIndex, start, splitStart, depth + 1);
+	};
+	auto buildRight = [&]() {
+		buildNode(primBounds, builder, nodeCount, leftIndex + 1, splitStart, end, depth + 1);
+	};
+	if (count > taskThreshold)
+		tbb::parallel_invoke(buildLeft, buildRight);
+	else {
+		buildLeft();
+		buildRight();
+	}
+}
+
+float BVH::sahCost() const {
+	return cost;
+}
+
+float BVH::buildTime() const {
+	return buildSeconds;
+}
+
+int BVH::nodeNum() const {
+	return static_cast<int>(width == 4 ? wideTree4.size() : wideTree8.size());
+}
+
+std::pair<int, int> BVH::locateTriangle(int primIndex) const {
+	auto next = std::upper_bound(meshTriangleOffset.begin(), meshTriangleOffset.end(), primIndex);
+	int meshIndex = static_cast<int>(next - meshTriangleOffset.begin()) - 1;
+	return std::make_pair(meshIndex, primIndex - meshTriangleOffset[meshIndex]);
+}
+
+template <int N>
+void BVH::collapseNode(const std::vector<Mesh>& meshes, std::vector<WideNode<N>>& wideTree,
+					   std::vector<TriangleBlock<N>>& triangleBlocks, int binaryIndex, int wideIndex) const {
+	// ȡӽڵ㣬ٲչбڲڵ㣬ֱN
+	std::array<int, N> children;
+	int childNum = 0;
+	const auto& node = linearTree[binaryIndex];
+	if (node.primCount > 0)
+		children[childNum++] = binaryIndex;  // ֻһҶڵ
+	else if (node.left >= 0) {
+		children[childNum++] = node.left;
+		children[childNum++] = node.right;
+	}
+	while (childNum < N) {
+		int selected = -1;
+		float maxArea = -1.0f;
+		for (int i = 0; i < childNum; ++i) {
+			const auto& child = linearTree[children[i]];
+			if (child.primCount == 0) {
+				float area = surfaceArea(child.aabb.min, child.aabb.max);
+				if (area > maxArea) {
+					maxArea = area;
+					selected = i;
 				}
 			}
-			node->left = std::make_unique<TreeNode>(-1, min, max);
-			s.push(std::make_tuple(node->left.get(), start, splitStart));
-
-			// ҵһֵİΧ
-			min = Eigen::Vector4f::Constant(FLT_MAX);
-			max = Eigen::Vector4f::Constant(-FLT_MAX);
-			for (int i = splitStart; i < end; ++i) {
-				int vertexIndex = leafList[i]->index;
-				const auto& vertex = triangles[vertexIndex].vertexPosition;
-				for (int j = 0; j < 3; ++j) {
-					min = min.cwiseMin(vertex(j));
-					max = max.cwiseMax(vertex(j));
+		}
+		if (selected < 0)
+			break;
+
+		const auto& expanded = linearTree[children[selected]];
+		children[selected] = expanded.left;
+		children[childNum++] = expanded.right;
+	}
+
+	// дӽڵ㣬ڲӽڵ䣬ݹ
+	// wideTreeݣֻͨ±
+	for (int i = 0; i < N; ++i) {
+		if (i < childNum) {
+			const auto& child = linearTree[children[i]];
+			for (int axis = 0; axis < 3; ++axis) {
+				wideTree[wideIndex].bounds[axis][i] = child.aabb.min(axis);
+				wideTree[wideIndex].bounds[axis + 3][i] = child.aabb.max(axis);
+			}
+			if (child.primCount > 0) {
+				// ҶڵΰNһ
+				int blockCount = (child.primCount + N - 1) / N;
+				wideTree[wideIndex].child[i] = static_cast<int>(triangleBlocks.size());
+				wideTree[wideIndex].blockCount[i] = blockCount;
+				for (int j = 0; j < blockCount; ++j) {
+					auto& block = triangleBlocks.emplace_back();
+					for (int lane = 0; lane < N; ++lane) {
+						int primIndex = j * N + lane;
+						if (primIndex < child.primCount) {
+							auto [meshIndex, triangleIndex] = locateTriangle(primIndices[child.primStart + primIndex]);
+							const auto& mesh = meshes[meshIndex];
+							const auto& v2 = mesh.position(triangleIndex, 2);
+							Eigen::Vector4f edge1 = mesh.position(triangleIndex, 0) - v2;
+							Eigen::Vector4f edge2 = mesh.position(triangleIndex, 1) - v2;
+							for (int axis = 0; axis < 3; ++axis) {
+								block.vertex[axis][lane] = v2(axis);
+								block.edge1[axis][lane] = edge1(axis);
+								block.edge2[axis][lane] = edge2(axis);
+							}
+							block.meshIndex[lane] = meshIndex;
+							block.triangleIndex[lane] = triangleIndex;
+						}
+						else {
+							// λ˻ΣʽΪ0ཻ
+							for (int axis = 0; axis < 3; ++axis) {
+								block.vertex[axis][lane] = 0.0f;
+								block.edge1[axis][lane] = 0.0f;
+								block.edge2[axis][lane] = 0.0f;
+							}
+							block.meshIndex[lane] = -1;
+							block.triangleIndex[lane] = -1;
+						}
+					}
 				}
 			}
-			node->right = std::make_unique<TreeNode>(-1, min, max);
-			s.push(std::make_tuple(node->right.get(), splitStart, end));
+			else {
+				wideTree[wideIndex].child[i] = static_cast<int>(wideTree.size());
+				wideTree[wideIndex].blockCount[i] = 0;
+				wideTree.emplace_back();
+			}
+		}
+		else {
+			// λİΧΪգκι߶ཻ
+			for (int axis = 0; axis < 3; ++axis) {
+				wideTree[wideIndex].bounds[axis][i] = FLT_MAX;
+				wideTree[wideIndex].bounds[axis + 3][i] = -FLT_MAX;
+			}
+			wideTree[wideIndex].child[i] = -1;
+			wideTree[wideIndex].blockCount[i] = -1;
 		}
-	} while (!s.empty());
+	}
+	for (int i = 0; i < childNum; ++i) {
+		if (wideTree[wideIndex].blockCount[i] == 0)
+			collapseNode(meshes, wideTree, triangleBlocks, children[i], wideTree[wideIndex].child[i]);
+	}
+}
+
+// NSIMD㣬4SSE8AVX
+template <int N>
+struct Simd;
 
-	// ת
-	std::vector<TreeNode*> ptrQueue;
-	ptrQueue.push_back(root.get());
-	linearTree.emplace_back(*root);
-	for (int i = 0; i < ptrQueue.size(); ++i) {
-		auto nodePtr = ptrQueue[i];
-		if (nodePtr->left) {
-			ptrQueue.push_back(nodePtr->left.get());
-			linearTree[i].left = ptrQueue.size() - 1;
-			linearTree.emplace_back(*(nodePtr->left));
+template <>
+struct Simd<4> {
+	using Float = __m128;
+	static Float load(const float* p) { return _mm_load_ps(p); }
+	static void store(float* p, Float a) { _mm_store_ps(p, a); }
+	static Float set1(float a) { return _mm_set1_ps(a); }
+	static Float zero() { return _mm_setzero_ps(); }
+	static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+	// a * b - c
+	static Float fmsub(Float a, Float b, Float c) { return _mm_fmsub_ps(a, b, c); }
+	// a * b + c
+	static Float fmadd(Float a, Float b, Float c) { return _mm_fmadd_ps(a, b, c); }
+	static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+	static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+	// ȽϽΪȫ1ȫ0룬NaNıȽ϶Ϊ
+	static Float less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+	static Float lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+	static Float bitAnd(Float a, Float b) { return _mm_and_ps(a, b); }
+	static int mask(Float a) { return _mm_movemask_ps(a); }
+};
+
+template <>
+struct Simd<8> {
+	using Float = __m256;
+	static Float load(const float* p) { return _mm256_load_ps(p); }
+	static void store(float* p, Float a) { _mm256_store_ps(p, a); }
+	static Float set1(float a) { return _mm256_set1_ps(a); }
+	static Float zero() { return _mm256_setzero_ps(); }
+	static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+	static Float fmsub(Float a, Float b, Float c) { return _mm256_fmsub_ps(a, b, c); }
+	static Float fmadd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+	static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+	static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+	static Float less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Float lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Float bitAnd(Float a, Float b) { return _mm256_and_ps(a, b); }
+	static int mask(Float a) { return _mm256_movemask_ps(a); }
+};
+
+// ߵSIMDʽÿ㲥ͨһμNӽڵN
+template <int N>
+struct WideRay {
+	using S = Simd<N>;
+	typename S::Float origin[3];
+	typename S::Float direction[3];
+	typename S::Float invD[3];
+	// ȽһboundsекţΪʱȽmax
+	int nearRow[3];
+	int farRow[3];
+
+	WideRay(const Ray& r) {
+		Eigen::Vector4f invDirection = r.direction.cwiseInverse();
+		for (int axis = 0; axis < 3; ++axis) {
+			origin[axis] = S::set1(r.origin(axis));
+			direction[axis] = S::set1(r.direction(axis));
+			invD[axis] = S::set1(invDirection(axis));
+			nearRow[axis] = invDirection(axis) < 0.0f ? axis + 3 : axis;
+			farRow[axis] = invDirection(axis) < 0.0f ? axis : axis + 3;
 		}
-		if (nodePtr->right) {
-			ptrQueue.push_back(nodePtr->right.get());
-			linearTree[i].right = ptrQueue.size() - 1;
-			linearTree.emplace_back(*(nodePtr->right));
+	}
+
+	// ཻӽڵ룬distanceдӽڵĽ
+	int intersect(const WideNode<N>& node, float tmax, float* distance) const {
+		auto tNear = S::zero();
+		auto tFar = S::set1(tmax);
+		for (int axis = 0; axis < 3; ++axis) {
+			auto t0 = S::mul(S::sub(S::load(node.bounds[nearRow[axis]]), origin[axis]), invD[axis]);
+			auto t1 = S::mul(S::sub(S::load(node.bounds[farRow[axis]]), origin[axis]), invD[axis]);
+			tNear = S::max(tNear, t0);
+			tFar = S::min(tFar, t1);
 		}
+		S::store(distance, tNear);
+		return S::mask(S::lessEqual(tNear, tFar));
 	}
+
+	// Moller-Trumbore㷨(rayEpsilon, tmax)ཻ룬tдֻͨʱɴָ
+	// ƽк˻βNaNҲų
+	int intersect(const TriangleBlock<N>& block, float tmax,
+				  float* t = nullptr, float* alpha = nullptr, float* beta = nullptr) const {
+		typename S::Float edge1[3], edge2[3], toOrigin[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			edge1[axis] = S::load(block.edge1[axis]);
+			edge2[axis] = S::load(block.edge2[axis]);
+			toOrigin[axis] = S::sub(origin[axis], S::load(block.vertex[axis]));
+		}
+
+		// p = direction x edge2
+		auto px = S::fmsub(direction[1], edge2[2], S::mul(direction[2], edge2[1]));
+		auto py = S::fmsub(direction[2], edge2[0], S::mul(direction[0], edge2[2]));
+		auto pz = S::fmsub(direction[0], edge2[1], S::mul(direction[1], edge2[0]));
+		auto det = S::fmadd(edge1[0], px, S::fmadd(edge1[1], py, S::mul(edge1[2], pz)));
+		auto invDet = S::div(S::set1(1.0f), det);
+
+		auto u = S::mul(S::fmadd(toOrigin[0], px, S::fmadd(toOrigin[1], py, S::mul(toOrigin[2], pz))), invDet);
+
+		// q = toOrigin x edge1
+		auto qx = S::fmsub(toOrigin[1], edge1[2], S::mul(toOrigin[2], edge1[1]));
+		auto qy = S::fmsub(toOrigin[2], edge1[0], S::mul(toOrigin[0], edge1[2]));
+		auto qz = S::fmsub(toOrigin[0], edge1[1], S::mul(toOrigin[1], edge1[0]));
+		auto v = S::mul(S::fmadd(direction[0], qx, S::fmadd(direction[1], qy, S::mul(direction[2], qz))), invDet);
+		auto tv = S::mul(S::fmadd(edge2[0], qx, S::fmadd(edge2[1], qy, S::mul(edge2[2], qz))), invDet);
+
+		auto accept = S::bitAnd(S::lessEqual(S::zero(), u), S::lessEqual(S::zero(), v));
+		accept = S::bitAnd(accept, S::lessEqual(S::add(u, v), S::set1(1.0f)));
+		accept = S::bitAnd(accept, S::less(S::set1(rayEpsilon), tv));
+		accept = S::bitAnd(accept, S::less(tv, S::set1(tmax)));
+		int mask = S::mask(accept);
+		if (mask != 0 && t != nullptr) {
+			S::store(t, tv);
+			S::store(alpha, u);
+			S::store(beta, v);
+		}
+		return mask;
+	}
+};
+
+HitRecord BVH::hit(const Ray& r, float tmax) const {
+	if (width == 4)
+		return hitWide(wideTree4, triangleBlocks4, r, tmax);
+	else
+		return hitWide(wideTree8, triangleBlocks8, r, tmax);
+}
+
+bool BVH::occluded(const Ray& r, float tmax) const {
+	if (width == 4)
+		return occludedWide(wideTree4, triangleBlocks4, r, tmax);
+	else
+		return occludedWide(wideTree8, triangleBlocks8, r, tmax);
 }
 
-const std::vector<int>& BVH::hit(const Ray& r) const {
-	// ̬򣬼ٿռ俪
-	thread_local static std::vector<int> result;
+// ջеһcount0ʱΪҶڵ㣬indexΪһο±
+struct StackEntry {
+	int index;
+	int count;
+	float distance;
+};
 
-	// ջռݹջ32㹻ڸڵ
-	std::array<int, 32> stack = { 0 };
-	result.clear();
+template <int N>
+HitRecord BVH::hitWide(const std::vector<WideNode<N>>& wideTree, const std::vector<TriangleBlock<N>>& triangleBlocks,
+					   const Ray& r, float tmax) const {
+	HitRecord record = { tmax, 0.0f, 0.0f, -1, -1 };
+	WideRay<N> wideRay(r);
+
+	// ջռݹջÿN-1ʵֵܽڵ
+	// ͬʱ¼ڵĽ룬ջʱѾԶڵǰĽڵֱ
+	std::array<StackEntry, N * maxDepth> stack;
+	stack[0] = { 0, 0, 0.0f };
 	int stackSize = 1;
 	do {
-		int nodeIndex = stack[stackSize - 1];
+		auto entry = stack[stackSize - 1];
 		stackSize--;
-		const auto& node = linearTree[nodeIndex];
-		bool hasHit = node.aabb.hit(r);
-		if (hasHit) {
-			if (node.vertexIndex >= 0)
-				result.push_back(node.vertexIndex);
-			else {
-				if (node.left > 0) {
-					stack[stackSize] = node.left;
-					stackSize++;
+		if (entry.distance > record.t)
+			continue;
+
+		if (entry.count > 0) {
+			for (int i = entry.index; i < entry.index + entry.count; ++i) {
+				const auto& block = triangleBlocks[i];
+				alignas(32) float t[N];
+				alignas(32) float alpha[N];
+				alignas(32) float beta[N];
+				int mask = wideRay.intersect(block, record.t, t, alpha, beta);
+				for (int lane = 0; lane < N; ++lane) {
+					if ((mask & (1 << lane)) && t[lane] < record.t) {
+						record.t = t[lane];
+						record.alpha = alpha[lane];
+						record.beta = beta[lane];
+						record.meshIndex = block.meshIndex[lane];
+						record.triangleIndex = block.triangleIndex[lane];
+					}
 				}
-				if (node.right > 0) {
-					stack[stackSize] = node.right;
-					stackSize++;
+			}
+			continue;
+		}
+
+		const auto& node = wideTree[entry.index];
+		alignas(32) float distance[N];
+		int mask = wideRay.intersect(node, record.t, distance);
+
+		// ཻӽڵ㰴Զջȳջ
+		std::array<StackEntry, N> hitChildren;
+		int hitNum = 0;
+		for (int i = 0; i < N; ++i) {
+			if (mask & (1 << i)) {
+				StackEntry child = { node.child[i], node.blockCount[i], distance[i] };
+				int j = hitNum;
+				while (j > 0 && hitChildren[j - 1].distance < child.distance) {
+					hitChildren[j] = hitChildren[j - 1];
+					j--;
 				}
+				hitChildren[j] = child;
+				hitNum++;
 			}
 		}
+		for (int i = 0; i < hitNum; ++i) {
+			stack[stackSize++] = hitChildren[i];
+		}
+	} while (stackSize != 0);
+
+	return record;
+}
+
+template <int N>
+bool BVH::occludedWide(const std::vector<WideNode<N>>& wideTree, const std::vector<TriangleBlock<N>>& triangleBlocks,
+					   const Ray& r, float tmax) const {
+	WideRay<N> wideRay(r);
+
+	// ⽻㼴ɷأӽڵ㲻Ҳ¼
+	std::array<StackEntry, N * maxDepth> stack;
+	stack[0] = { 0, 0, 0.0f };
+	int stackSize = 1;
+	do {
+		auto entry = stack[stackSize - 1];
+		stackSize--;
+
+		if (entry.count > 0) {
+			for (int i = entry.index; i < entry.index + entry.count; ++i) {
+				if (wideRay.intersect(triangleBlocks[i], tmax) != 0)
+					return true;
+			}
+			continue;
+		}
+
+		const auto& node = wideTree[entry.index];
+		alignas(32) float distance[N];
+		int mask = wideRay.intersect(node, tmax, distance);
+		for (int i = 0; i < N; ++i) {
+			if (mask & (1 << i))
+				stack[stackSize++] = { node.child[i], node.blockCount[i], 0.0f };
+		}
 	} while (stackSize != 0);
 
-	return result;
+	return false;
 }
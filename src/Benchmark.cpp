@@ -0,0 +1,55 @@
+#include <RayTracer/Benchmark.h>
+#include <RayTracer/Texture.h>
+#include <RayTracer/Random.h>
+#include <iostream>
+#include <chrono>
+#include <exception>
+#include <cmath>
+
+// ÿַģʽĲΪ sampleGrid * sampleGrid
+constexpr int sampleGrid = 2048;
+
+void textureBenchmark(std::string_view path) {
+	const char* layoutNames[] = { "linear", "tiled" };
+	const char* patternNames[] = { "rows", "rotated", "random" };
+
+	for (int layout = 0; layout < 2; ++layout) {
+		Texture texture(path);
+		if (!texture.hasTexture())
+			throw std::exception("Can't load texture");
+
+		TextureOptions options;
+		options.filter = TextureFilter::Bilinear;
+		options.layout = static_cast<TextureLayout>(layout);
+		texture.prepare(options);
+
+		for (int pattern = 0; pattern < 3; ++pattern) {
+			// ۼӽֹŻ
+			Eigen::Vector4f sum = Eigen::Vector4f::Zero();
+			auto time1 = std::chrono::system_clock::now();
+			for (int y = 0; y < sampleGrid; ++y) {
+				for (int x = 0; x < sampleGrid; ++x) {
+					float u = (x + 0.5f) / sampleGrid;
+					float v = (y + 0.5f) / sampleGrid;
+					if (pattern == 1) {
+						// ൱ڻбŵƽ棬ɨƶʱϿ
+						float cu = u - 0.5f;
+						float cv = v - 0.5f;
+						u = 0.5f + 0.5f * cu - 0.866f * cv;
+						v = 0.5f + 0.866f * cu + 0.5f * cv;
+					}
+					else if (pattern == 2) {
+						uint32_t hash = Random::hash(y * sampleGrid + x);
+						u = (hash & 0xFFFF) / 65536.0f;
+						v = (hash >> 16) / 65536.0f;
+					}
+					sum += texture.sampleTexture(Eigen::Vector2f(u, v));
+				}
+			}
+			auto time2 = std::chrono::system_clock::now();
+			float seconds = std::chrono::duration<float>(time2 - time1).count();
+			std::cout << layoutNames[layout] << " " << patternNames[pattern] << ": " << seconds << "s, "
+				<< sampleGrid * sampleGrid / seconds / 1e6f << "M samples/s (checksum " << sum.sum() << ")\n";
+		}
+	}
+}
\ No newline at end of file
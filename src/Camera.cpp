@@ -31,19 +31,17 @@ void Camera::setCamera(const Eigen::Vector4f& origin, const Eigen::Vector4f& vie
 	downStep = rotateMatrix * downStep;
 }
 
-// SSAA 4x sampling
-// 1  2
-// 3  4
-constexpr std::array<float, 4> xOffset = { -0.25f, 0.25f, -0.25f, 0.25f };
-constexpr std::array<float, 4> yOffset = { -0.25f, -0.25f, 0.25f, 0.25f };
+// u, vΪ[0, 1)֮ƫ
+Ray Camera::getRay(int x, int y, float u, float v) const {
+	float xTemp = x + (u - 0.5f);
+	float yTemp = y + (v - 0.5f);
+	Ray result(origin, leftUpCorner + xTemp * rightStep + yTemp * downStep);
 
-std::array<Ray, 4> Camera::getRay(int x, int y) const {
-	std::array<Ray, 4> result;
-	for (int i = 0; i < 4; ++i) {
-		result[i].origin = origin;
-		float xTemp = x + xOffset[i];
-		float yTemp = y + yOffset[i];
-		result[i].direction = leftUpCorner + xTemp * rightStep + yTemp * downStep;
-	}
+	// Ĺͬصķһ
+	result.originDx = Eigen::Vector4f::Zero();
+	result.originDy = Eigen::Vector4f::Zero();
+	result.directionDx = rightStep;
+	result.directionDy = downStep;
+	result.hasDifferentials = true;
 	return result;
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <RayTracer/ImageWriter.h>
+#include <stb_image_write.h>
+#include <fstream>
+
+// PFMʽдϴ洢ıʾС
+static void writePfm(const std::string& path, const std::vector<float>& buffer, int width, int height) {
+	std::ofstream file(path, std::ios::binary);
+	file << "PF\n" << width << " " << height << "\n-1.0\n";
+	for (int row = height - 1; row >= 0; --row) {
+		file.write(reinterpret_cast<const char*>(buffer.data() + row * width * 3), sizeof(float) * width * 3);
+	}
+}
+
+ImageWriter::ImageWriter() : worker(&ImageWriter::run, this) { }
+
+ImageWriter::~ImageWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+std::string ImageWriter::submit(const std::string& path, const std::vector<uint8_t>& ldrBuffer,
+								const std::vector<float>& hdrBuffer, int width, int height) {
+	std::string dropped;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (hasPending)
+			dropped = pending.path;
+
+		// Ƶȴһεڴ
+		pending.path = path;
+		pending.ldrBuffer.assign(ldrBuffer.begin(), ldrBuffer.end());
+		pending.hdrBuffer.assign(hdrBuffer.begin(), hdrBuffer.end());
+		pending.width = width;
+		pending.height = height;
+		hasPending = true;
+	}
+	condition.notify_all();
+	return dropped;
+}
+
+void ImageWriter::finish() {
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]() { return !hasPending && !writing; });
+}
+
+void ImageWriter::run() {
+	Image current;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this]() { return hasPending || stop; });
+		if (!hasPending)
+			return;
+
+		std::swap(current, pending);
+		hasPending = false;
+		writing = true;
+		lock.unlock();
+
+		if (!current.ldrBuffer.empty()) {
+			stbi_write_png((current.path + ".png").c_str(), current.width, current.height, 3,
+						   current.ldrBuffer.data(), 3 * current.width);
+		}
+		if (!current.hdrBuffer.empty())
+			writePfm(current.path + ".pfm", current.hdrBuffer, current.width, current.height);
+
+		lock.lock();
+		writing = false;
+		condition.notify_all();
+	}
+}
@@ -0,0 +1,61 @@
+#include <RayTracer/Light.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+
+void LightList::build(const std::vector<Mesh>& meshes, const std::vector<Material>& materials) {
+	triangles.clear();
+	cdf.clear();
+	totalArea = 0.0f;
+
+	for (const auto& mesh : meshes) {
+		const auto& material = materials[mesh.materialIndex];
+		if (!material.isLightEmitting)
+			continue;
+
+		for (int i = 0; i < mesh.triangleNum(); ++i) {
+			LightTriangle triangle;
+			for (int k = 0; k < 3; ++k) {
+				uint32_t index = mesh.indices[i * 3 + k];
+				triangle.vertex[k] = mesh.positions[index];
+				triangle.normal[k] = mesh.normals[index];
+			}
+			triangle.emission = material.color;
+
+			float area = 0.5f * (triangle.vertex[1] - triangle.vertex[0])
+				.cross3(triangle.vertex[2] - triangle.vertex[0]).norm();
+			if (area <= 0.0f)
+				continue;
+
+			totalArea += area;
+			triangles.push_back(triangle);
+			cdf.push_back(totalArea);
+		}
+	}
+}
+
+bool LightList::hasLight() const {
+	return !triangles.empty();
+}
+
+LightSample LightList::sample(float u0, float u1, float u2) const {
+	// ֲۻֲ
+	auto iter = std::upper_bound(cdf.begin(), cdf.end(), u0 * totalArea);
+	size_t index = std::min(static_cast<size_t>(iter - cdf.begin()), triangles.size() - 1);
+	const auto& triangle = triangles[index];
+
+	// ϵľȷֲ
+	float squareRoot = sqrtf(u1);
+	float alpha = 1.0f - squareRoot;
+	float beta = u2 * squareRoot;
+	float gamma = 1.0f - (alpha + beta);
+
+	LightSample result;
+	result.position = alpha * triangle.vertex[0] + beta * triangle.vertex[1] + gamma * triangle.vertex[2];
+	result.normal = (alpha * triangle.normal[0] + beta * triangle.normal[1] + gamma * triangle.normal[2]).normalized();
+	result.emission = triangle.emission;
+	return result;
+}
+
+float LightList::areaPdf() const {
+	return 1.0f / totalArea;
+}
@@ -0,0 +1,131 @@
+#include <RayTracer/Material.h>
+#include <algorithm>
+
+constexpr float pi = 3.1415926f;
+
+// normalΪzľֲת
+// refer to: Building an Orthonormal Basis, Revisited (Duff et al. 2017)
+static Eigen::Vector4f toWorld(const Eigen::Vector4f& normal, float x, float y, float z) {
+	float sign = copysignf(1.0f, normal.z());
+	float a = -1.0f / (sign + normal.z());
+	float b = normal.x() * normal.y() * a;
+	Eigen::Vector4f tangent(1.0f + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x(), 0.0f);
+	Eigen::Vector4f bitangent(b, sign + normal.y() * normal.y() * a, -normal.y(), 0.0f);
+	return x * tangent + y * bitangent + z * normal;
+}
+
+// GGXSmith LambdacosineΪ뷨߼нǵ
+static float smithLambda(float cosine, float squareAlpha) {
+	float squareCosine = cosine * cosine;
+	return 0.5f * (sqrtf(1.0f + squareAlpha * (1.0f - squareCosine) / squareCosine) - 1.0f);
+}
+
+ScatterSample Material::diffuse(const Eigen::Vector4f& normal, const Ray& r, float u1, float u2) const {
+	// ָķ
+	Eigen::Vector4f tempNormal = (r.direction.dot(normal)) < 0.0f ? normal : -normal;
+
+	// ϰҷֲpdf = cos / PI
+	float phi = 2.0f * pi * u1;
+	float squareSine = u2;
+	float sine = sqrtf(squareSine);
+	float cosine = sqrtf(1.0f - squareSine);
+
+	ScatterSample result;
+	result.direction = toWorld(tempNormal, sine * cosf(phi), sine * sinf(phi), cosine);
+	result.pdf = cosine * (1.0f / pi);
+
+	// Lambert: (color / PI) * cos / pdf
+	result.weight = color;
+	return result;
+}
+
+float Material::diffusePdf(const Eigen::Vector4f& normal, const Ray& r, const Eigen::Vector4f& direction) const {
+	Eigen::Vector4f tempNormal = (r.direction.dot(normal)) < 0.0f ? normal : -normal;
+	float cosine = tempNormal.dot(direction.normalized());
+	return cosine > 0.0f ? cosine * (1.0f / pi) : 0.0f;
+}
+
+// refer to: Microfacet Models for Refraction through Rough Surfaces (Walter et al. 2007)
+ScatterSample Material::specular(const Eigen::Vector4f& normal, const Ray& r, float u1, float u2) const {
+	Eigen::Vector4f tempNormal = (r.direction.dot(normal)) < 0.0f ? normal : -normal;
+	Eigen::Vector4f out = -r.direction.normalized();
+	float outCosine = tempNormal.dot(out);
+
+	// specularRoughnessΪGGXalphaСʱֵȶ
+	float alpha = std::clamp(specularRoughness, 0.001f, 1.0f);
+	float squareAlpha = alpha * alpha;
+
+	// D(h) * cos(h)΢淨
+	float phi = 2.0f * pi * u1;
+	float squareCosineH = (1.0f - u2) / (1.0f + (squareAlpha - 1.0f) * u2);
+	float cosineH = sqrtf(squareCosineH);
+	float sineH = sqrtf(1.0f - squareCosineH);
+	Eigen::Vector4f half = toWorld(tempNormal, sineH * cosf(phi), sineH * sinf(phi), cosineH);
+
+	float outDotHalf = out.dot(half);
+	ScatterSample result;
+	result.direction = 2.0f * outDotHalf * half - out;
+	float inCosine = tempNormal.dot(result.direction);
+
+	// 䵽µĲЧ
+	if (inCosine <= 0.0f || outCosine <= 0.0f || outDotHalf <= 0.0f) {
+		result.weight = Eigen::Vector4f::Zero();
+		result.pdf = 0.0f;
+		return result;
+	}
+
+	float temp = 1.0f + (squareAlpha - 1.0f) * squareCosineH;
+	float distribution = squareAlpha / (pi * temp * temp);
+	result.pdf = distribution * cosineH / (4.0f * outDotHalf);
+
+	// SchlickƵķɫΪF0ǽȡ0.04
+	// ͸ʵķrefractﲻټ
+	// ߶صSmithڱӰͳڵٵ¼ֲʱʧG1
+	// refer to: Understanding the Masking-Shadowing Function in Microfacet-Based BRDFs (Heitz 2014)
+	float geometry = 1.0f / (1.0f + smithLambda(outCosine, squareAlpha) + smithLambda(inCosine, squareAlpha));
+	float scale = geometry * outDotHalf / (outCosine * cosineH);
+	if (isTransparent) {
+		result.weight = Eigen::Vector4f::Constant(scale);
+	}
+	else {
+		Eigen::Vector4f f0 = isMetal ? color : Eigen::Vector4f(0.04f, 0.04f, 0.04f, 0.0f);
+		float squareTemp = (1.0f - outDotHalf) * (1.0f - outDotHalf);
+		float pow5 = squareTemp * squareTemp * (1.0f - outDotHalf);
+		Eigen::Vector4f fresnel = f0 + (Eigen::Vector4f(1.0f, 1.0f, 1.0f, 0.0f) - f0) * pow5;
+		result.weight = fresnel * scale;
+	}
+	return result;
+}
+
+// refer to: https://graphicscompendium.com/raytracing/10-reflection-refraction
+std::pair<float, Eigen::Vector4f> Material::refract(const Eigen::Vector4f& normal, const Ray& r) const {
+	float dot = r.direction.dot(normal);
+
+	// :
+	float indexRatio = dot > 0.0f ? refractiveIndex : (1.0f / refractiveIndex);
+
+	// ָķ
+	Eigen::Vector4f tempNormal = dot > 0.0f ? -normal : normal;
+
+	// ߺͷ֮ļнǵ
+	float cosineTheta = fabsf(dot);
+
+	// Ƿȫ
+	float squareSine1 = 1.0f - cosineTheta * cosineTheta;
+	float squareSine2 = (indexRatio * indexRatio) * squareSine1;
+	if (squareSine2 > 1.0f)
+		return std::make_pair(0.0f, Eigen::Vector4f::Zero());
+
+	// 
+	float cosine2 = sqrtf(1.0f - squareSine2);
+	Eigen::Vector4f outRay = indexRatio * (r.direction + cosineTheta * tempNormal) - tempNormal * cosine2;
+
+	// ıSchlick's approximation
+	float temp = (1.0f - indexRatio) / (1.0f + indexRatio);
+	float r0 = temp * temp;
+	float squareTemp = (1.0f - cosineTheta) * (1.0f - cosineTheta);
+	float pow5 = squareTemp * squareTemp * (1.0f - cosineTheta);
+	float reflectProportion = r0 + (1.0f - r0) * pow5;
+
+	return std::make_pair(1.0f - reflectProportion, outRay);
+}
@@ -7,6 +7,11 @@
 #include <cfloat>
 #include <chrono>
 #include <exception>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iterator>
+#include <immintrin.h>
 
 #include <assimp/Importer.hpp>
 #include <assimp/cimport.h>
@@ -15,7 +20,54 @@
 
 #include <Eigen/Geometry>
 #include <tbb/tbb.h>
-#include <stb_image_write.h>
+
+// ȡļȫݣʧʱؿ
+static std::vector<char> readFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// 64λFNV-1aϣ
+static uint64_t contentHash(const std::vector<char>& content) {
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : content) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+int RayTracer::loadTexture(std::string_view path) {
+	std::error_code error;
+	auto canonical = std::filesystem::weakly_canonical(std::filesystem::path(path), error);
+	std::string key = error ? std::string(path) : canonical.string();
+	auto pathIter = texturePaths.find(key);
+	if (pathIter != texturePaths.end())
+		return pathIter->second;
+
+	Texture tex(key);
+	if (!tex.hasTexture()) {
+		texturePaths.emplace(key, -1);
+		return -1;
+	}
+
+	// ·ͬͬļϣͬʱٱȽȫ
+	auto content = readFile(key);
+	uint64_t hash = contentHash(content);
+	auto range = textureHashes.equal_range(hash);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		if (readFile(texturesArray[iter->second].filePath()) == content) {
+			texturePaths.emplace(key, iter->second);
+			return iter->second;
+		}
+	}
+
+	int index = static_cast<int>(texturesArray.size());
+	texturesArray.push_back(std::move(tex));
+	texturePaths.emplace(key, index);
+	textureHashes.emplace(hash, index);
+	return index;
+}
 
 void RayTracer::loadModel(std::string_view modelPath,
 						  const Eigen::Vector4f& origin,
@@ -58,51 +110,61 @@ void RayTracer::loadModel(std::string_view modelPath,
 
 	// ȷǷ
 	bool useTexture = texturePath.has_value();
+	int textureIndex = -1;
 	if (useTexture) {
 		useTexture = mesh->HasTextureCoords(0);
 		if (useTexture) {
-			Texture tex(texturePath.value());
-			if (!tex.hasTexture()) {
+			textureIndex = loadTexture(texturePath.value());
+			if (textureIndex < 0) {
 				useTexture = false;
 				std::cout << "Can't load texture in " << texturePath.value() << std::endl;
 			}
-			else
-				texturesArray.push_back(std::move(tex));
 		}
 		if (!useTexture)
 			std::cout << "No texture for model in " << modelPath << std::endl;
 	}
 
+	Material mat;
+	mat.isMetal = isMetal;
+	mat.isLightEmitting = isLightEmitting;
+	mat.isTransparent = isTransparent;
+	mat.specularRoughness = specularRoughness;
+	mat.refractiveIndex = refIndex;
+	mat.color = finalColor;
+	mat.textureIndex = textureIndex;
+	int matIndex = materialsArray.size();
+	materialsArray.push_back(mat);
+
+	// 帴ƣֻ
+	Mesh newMesh;
+	newMesh.materialIndex = matIndex;
+	unsigned vertexNum = mesh->mNumVertices;
+	newMesh.positions.resize(vertexNum);
+	newMesh.normals.resize(vertexNum);
+	if (useTexture)
+		newMesh.uvCoordinates.resize(vertexNum);
+	for (unsigned j = 0; j < vertexNum; ++j) {
+		const auto& vertex = mesh->mVertices[j];
+		newMesh.positions[j] = Eigen::Vector4f(vertex.x, vertex.y, vertex.z, 0.0f) * scale + origin;
+
+		const auto& normal = mesh->mNormals[j];
+		newMesh.normals[j] = Eigen::Vector4f(normal.x, normal.y, normal.z, 0.0f);
+
+		if (useTexture) {
+			const auto& uv = mesh->mTextureCoords[0][j];
+			newMesh.uvCoordinates[j] = Eigen::Vector2f(uv.x, uv.y);
+		}
+	}
+
 	unsigned faceNum = mesh->mNumFaces;
-	trianglesArray.reserve(faceNum + trianglesArray.size());
+	newMesh.indices.resize(faceNum * 3);
 	for (unsigned j = 0; j < faceNum; ++j) {
 		const auto& face = mesh->mFaces[j];
-		Triangle tri;
 		for (int k = 0; k < 3; ++k) {
-			unsigned index = face.mIndices[k];
-
-			const auto& vertex = mesh->mVertices[index];
-			tri.vertexPosition(k) = Eigen::Vector4f(vertex.x, vertex.y, vertex.z, 0.0f) * scale + origin;
-
-			const auto& normal = mesh->mNormals[index];
-			tri.vertexNormal(k) = Eigen::Vector4f(normal.x, normal.y, normal.z, 0.0f);
-
-			if (useTexture) {
-				const auto& uvCoordinate = mesh->mTextureCoords[0][index];
-				tri.uvCoordinate(k) = Eigen::Vector2f(uvCoordinate.x, uvCoordinate.y);
-			}
+			newMesh.indices[j * 3 + k] = face.mIndices[k];
 		}
-
-		tri.planeNormal = (tri.vertexPosition(1) - tri.vertexPosition(0)).cross3(tri.vertexPosition(2) - tri.vertexPosition(0)).normalized();
-		tri.isMetal = isMetal;
-		tri.isLightEmitting = isLightEmitting;
-		tri.isTransparent = isTransparent;
-		tri.specularRoughness = specularRoughness;
-		tri.refractiveIndex = refIndex;
-		tri.color = finalColor;
-		tri.textureIndex = useTexture ? texturesArray.size() - 1 : -1;
-		trianglesArray.push_back(tri);
 	}
+	meshesArray.push_back(std::move(newMesh));
 }
 
 void RayTracer::addTriangle(const Eigen::Vector4f& vertex0,
@@ -112,164 +174,611 @@ void RayTracer::addTriangle(const Eigen::Vector4f& vertex0,
 							const Eigen::Vector4f& color,
 							bool isMetal, bool isLightEmitting, bool isTransparent,
 							float specularRoughness, float refractiveIndex) {
-	Triangle tri;
-	tri.vertexPosition[0] = vertex0;
-	tri.vertexPosition[1] = vertex1;
-	tri.vertexPosition[2] = vertex2;
-	tri.planeNormal = (tri.vertexPosition(1) - tri.vertexPosition(0)).cross3(tri.vertexPosition(2) - tri.vertexPosition(0)).normalized();
-	if (normalSide.dot(tri.planeNormal) < 0.0f)
-		tri.planeNormal = -tri.planeNormal;
-
-	for (int i = 0; i < 3; ++i) {
-		tri.vertexNormal(i) = tri.planeNormal;
-	}
-	tri.color = color;
-	tri.isMetal = isMetal;
-	tri.isLightEmitting = isLightEmitting;
-	tri.isTransparent = isTransparent;
-	tri.specularRoughness = specularRoughness;
-	tri.refractiveIndex = refractiveIndex;
-	tri.textureIndex = -1;
-	trianglesArray.push_back(tri);
+	Eigen::Vector4f planeNormal = (vertex1 - vertex0).cross3(vertex2 - vertex0).normalized();
+	if (normalSide.dot(planeNormal) < 0.0f)
+		planeNormal = -planeNormal;
+
+	Material mat;
+	mat.color = color;
+	mat.isMetal = isMetal;
+	mat.isLightEmitting = isLightEmitting;
+	mat.isTransparent = isTransparent;
+	mat.specularRoughness = specularRoughness;
+	mat.refractiveIndex = refractiveIndex;
+	mat.textureIndex = -1;
+
+	// ҲΪһ
+	Mesh newMesh;
+	newMesh.positions = { vertex0, vertex1, vertex2 };
+	newMesh.normals = { planeNormal, planeNormal, planeNormal };
+	newMesh.indices = { 0, 1, 2 };
+	newMesh.materialIndex = materialsArray.size();
+	materialsArray.push_back(mat);
+	meshesArray.push_back(std::move(newMesh));
 }
 
-Eigen::Vector4f RayTracer::color(int depth, const Ray& r) const {
-	const auto& hitList = bvh.hit(r);
-
-	float t = FLT_MAX;
-	int index = -1;
-	float alpha, beta;
-	for (int i = 0; i < hitList.size(); ++i) {
-		const auto& tri = trianglesArray[hitList[i]];
-		const auto& hitCheck = tri.hit(r);
-		if (hitCheck(2) < t) {
-			index = hitList[i];
-			t = hitCheck(2);
-			alpha = hitCheck(0);
-			beta = hitCheck(1);
+std::optional<RayTracer::HitInfo> RayTracer::intersect(const Ray& r) const {
+	const auto& record = bvh.hit(r);
+	int index = record.triangleIndex;
+	if (index == -1)
+		return std::nullopt;
+
+	// ɫͨȡ
+	const auto& mesh = meshesArray[record.meshIndex];
+	uint32_t vertexIndex0 = mesh.indices[index * 3];
+	uint32_t vertexIndex1 = mesh.indices[index * 3 + 1];
+	uint32_t vertexIndex2 = mesh.indices[index * 3 + 2];
+	float alpha = record.alpha;
+	float beta = record.beta;
+
+	HitInfo info;
+	info.material = &materialsArray[mesh.materialIndex];
+	info.hitPoint = r.origin + record.t * r.direction;
+	Eigen::Vector4f interpolatedNormal = alpha * mesh.normals[vertexIndex0] + beta * mesh.normals[vertexIndex1] +
+		(1.0f - (alpha + beta)) * mesh.normals[vertexIndex2];
+	info.normal = interpolatedNormal.normalized();
+	if (info.material->textureIndex >= 0) {
+		info.uvCoordinate = alpha * mesh.uvCoordinates[vertexIndex0] + beta * mesh.uvCoordinates[vertexIndex1] +
+			(1.0f - (alpha + beta)) * mesh.uvCoordinates[vertexIndex2];
+	}
+
+	info.positionDx = Eigen::Vector4f::Zero();
+	info.positionDy = Eigen::Vector4f::Zero();
+	info.uvDx = Eigen::Vector2f::Zero();
+	info.uvDy = Eigen::Vector2f::Zero();
+	info.normalDx = Eigen::Vector4f::Zero();
+	info.normalDy = Eigen::Vector4f::Zero();
+	if (r.hasDifferentials) {
+		// صĹƽཻõλõĲ
+		// refer to: Tracing Ray Differentials (Igehy 1999)
+		Eigen::Vector4f edge1 = mesh.positions[vertexIndex0] - mesh.positions[vertexIndex2];
+		Eigen::Vector4f edge2 = mesh.positions[vertexIndex1] - mesh.positions[vertexIndex2];
+		Eigen::Vector4f planeNormal = edge1.cross3(edge2);
+		float directionDot = r.direction.dot(planeNormal);
+		if (directionDot != 0.0f) {
+			Eigen::Vector4f offsetX = r.originDx + record.t * r.directionDx;
+			Eigen::Vector4f offsetY = r.originDy + record.t * r.directionDy;
+			info.positionDx = offsetX - (offsetX.dot(planeNormal) / directionDot) * r.direction;
+			info.positionDy = offsetY - (offsetY.dot(planeNormal) / directionDot) * r.direction;
+		}
+
+		// λõĲ߱ʾõĲ֣ٲֵUVͷߵĲ
+		float a = edge1.dot(edge1);
+		float b = edge1.dot(edge2);
+		float c = edge2.dot(edge2);
+		float determinant = a * c - b * b;
+		if (determinant != 0.0f) {
+			auto barycentricDifferential = [&](const Eigen::Vector4f& positionDifferential) {
+				float d1 = edge1.dot(positionDifferential);
+				float d2 = edge2.dot(positionDifferential);
+				return Eigen::Vector2f((c * d1 - b * d2) / determinant, (a * d2 - b * d1) / determinant);
+			};
+			Eigen::Vector2f barycentricDx = barycentricDifferential(info.positionDx);
+			Eigen::Vector2f barycentricDy = barycentricDifferential(info.positionDy);
+
+			if (info.material->textureIndex >= 0) {
+				Eigen::Vector2f uvEdge1 = mesh.uvCoordinates[vertexIndex0] - mesh.uvCoordinates[vertexIndex2];
+				Eigen::Vector2f uvEdge2 = mesh.uvCoordinates[vertexIndex1] - mesh.uvCoordinates[vertexIndex2];
+				info.uvDx = barycentricDx(0) * uvEdge1 + barycentricDx(1) * uvEdge2;
+				info.uvDy = barycentricDy(0) * uvEdge1 + barycentricDy(1) * uvEdge2;
+			}
+
+			// ֵķ߾һȥط߷ķ
+			Eigen::Vector4f normalEdge1 = mesh.normals[vertexIndex0] - mesh.normals[vertexIndex2];
+			Eigen::Vector4f normalEdge2 = mesh.normals[vertexIndex1] - mesh.normals[vertexIndex2];
+			float normalLength = interpolatedNormal.norm();
+			auto normalDifferential = [&](const Eigen::Vector2f& barycentric) {
+				Eigen::Vector4f differential = barycentric(0) * normalEdge1 + barycentric(1) * normalEdge2;
+				return Eigen::Vector4f((differential - info.normal.dot(differential) * info.normal) / normalLength);
+			};
+			info.normalDx = normalDifferential(barycentricDx);
+			info.normalDy = normalDifferential(barycentricDy);
 		}
 	}
+	return info;
+}
 
-	// no hit
-	if (index == -1) {
-		if (skybox.hasSkybox())
-			return skybox.sampleBackground(r);
-		else
-			return backgroundColor;
+Eigen::Vector4f RayTracer::sampleTexture(const HitInfo& hit) const {
+	const auto& texture = texturesArray[hit.material->textureIndex];
+	return texture.sampleTexture(hit.uvCoordinate, hit.uvDx, hit.uvDy);
+}
+
+// ֵĳȣ䷽ֲϣ̶ĽϴŽǹƣ֮ѡýģĲ
+constexpr float diffuseSpread = 0.1f;
+
+// ¹ߵΪĲ֣ĲְĹϵ
+// refer to: Tracing Ray Differentials (Igehy 1999)
+Ray RayTracer::spawnRay(const Ray& r, const HitInfo& hit, const Eigen::Vector4f& direction, ScatterType type) const {
+	Ray result(hit.hitPoint, direction);
+	if (!r.hasDifferentials)
+		return result;
+	result.originDx = hit.positionDx;
+	result.originDy = hit.positionDy;
+	result.hasDifferentials = true;
+
+	if (type == ScatterType::Diffuse) {
+		Eigen::Vector4f axis = fabsf(direction.x()) > 0.9f ? Eigen::Vector4f::UnitY() : Eigen::Vector4f::UnitX();
+		Eigen::Vector4f tangent = direction.cross3(axis).normalized();
+		result.directionDx = diffuseSpread * tangent;
+		result.directionDy = diffuseSpread * direction.cross3(tangent).normalized();
+		return result;
 	}
 
-	const auto& tri = trianglesArray[index];
+	// ䷽һٴݣߵķǵλ
+	float length = r.direction.norm();
+	Eigen::Vector4f incident = r.direction / length;
+
+	// ʱԳ䷽İΪߣ뾵ʱΪɫߣGGXʱΪ΢淨
+	// ʱΪһɫߣetaΪ֮
+	Eigen::Vector4f normal;
+	float eta;
+	if (type == ScatterType::Reflect) {
+		normal = (direction - incident).normalized();
+		eta = 1.0f;
+	}
+	else {
+		bool inside = incident.dot(hit.normal) > 0.0f;
+		normal = inside ? -hit.normal : hit.normal;
+		eta = inside ? hit.material->refractiveIndex : 1.0f / hit.material->refractiveIndex;
+	}
+	float normalSign = normal.dot(hit.normal) >= 0.0f ? 1.0f : -1.0f;
+	float incidentCosine = incident.dot(normal);
+	float outCosine = direction.dot(normal);
+	if (outCosine == 0.0f) {
+		result.hasDifferentials = false;
+		return result;
+	}
 
-	Eigen::Vector4f hitPoint = r.origin + t * r.direction;
-	Eigen::Vector4f normal = alpha * tri.vertexNormal(0) + beta * tri.vertexNormal(1) +
-		(1.0f - (alpha + beta)) * tri.vertexNormal(2);
-	normal.normalize();
+	// ䷽ T = eta * D - mu * N
+	float mu = eta * incidentCosine - outCosine;
+	auto transfer = [&](const Eigen::Vector4f& directionDifferential, const Eigen::Vector4f& normalDifferential) {
+		Eigen::Vector4f incidentDifferential = (directionDifferential - incident.dot(directionDifferential) * incident) / length;
+		Eigen::Vector4f dN = normalSign * normalDifferential;
+		float cosineDifferential = incidentDifferential.dot(normal) + incident.dot(dN);
+		float muDifferential = (eta - eta * eta * incidentCosine / outCosine) * cosineDifferential;
+		return Eigen::Vector4f(eta * incidentDifferential - (mu * dN + muDifferential * normal));
+	};
+	result.directionDx = transfer(r.directionDx, hit.normalDx);
+	result.directionDy = transfer(r.directionDy, hit.normalDy);
+	return result;
+}
+
+Eigen::Vector4f RayTracer::background(const Ray& r) const {
+	if (skybox.hasSkybox())
+		return skybox.sampleBackground(r);
+	else
+		return backgroundColor;
+}
+
+Eigen::Vector4f RayTracer::color(int depth, const Ray& r, Sampler& sampler) const {
+	const auto& hit = intersect(r);
+
+	// no hit
+	if (!hit)
+		return background(r);
+
+	const auto& material = *hit->material;
+	const auto& normal = hit->normal;
 
 	// ignore rays coming from the back side
 	float cosine = normal.dot(r.direction);
-	if (depth == maxRecursionDepth || (!tri.isTransparent && cosine >= 0.0f))
+	if (depth == maxRecursionDepth || (!material.isTransparent && cosine >= 0.0f))
 		return Eigen::Vector4f::Zero();
 
-	if (tri.isLightEmitting)
-		return tri.color;
+	if (material.isLightEmitting)
+		return material.color;
 
 	// refer to: https://zhuanlan.zhihu.com/p/21961722?refer=highwaytographics
-	if (tri.isMetal) {
-		// specular reflection only
-		const auto& specularOutRay = tri.specular(normal, r, specualrRayNum);
-		Eigen::Vector4f specularColor = Eigen::Vector4f::Zero();
+	// ÿߵĹΪ weight * ⣬weightѳԲĸܶ
+	auto specularColor = [&]() {
+		Eigen::Vector4f sum = Eigen::Vector4f::Zero();
 		for (int i = 0; i < specualrRayNum; ++i) {
-			specularColor += color(depth + 1, Ray(hitPoint, specularOutRay[i]));
+			float u1 = sampler.next(), u2 = sampler.next();
+			const auto& sample = material.specular(normal, r, u1, u2);
+			if (sample.pdf > 0.0f)
+				sum += sample.weight.cwiseProduct(color(depth + 1, spawnRay(r, *hit, sample.direction, ScatterType::Reflect), sampler));
 		}
-		return specularColor.cwiseProduct(tri.color) / static_cast<float>(specualrRayNum);
+		return Eigen::Vector4f(sum / static_cast<float>(specualrRayNum));
+	};
+
+	if (material.isMetal) {
+		// specular reflection only
+		return specularColor();
 	}
 	else {
-		if (tri.isTransparent) {
-			const auto& specularOutRay = tri.specular(normal, r, specualrRayNum);
-			Eigen::Vector4f specularColor = Eigen::Vector4f::Zero();
-			for (int i = 0; i < specualrRayNum; ++i) {
-				specularColor += color(depth + 1, Ray(hitPoint, specularOutRay[i]));
-			}
-			specularColor /= static_cast<float>(specualrRayNum);
-
-			const auto& [refractProportion, refractOut] = tri.refract(normal, r);
-			Eigen::Vector4f refractColor = color(depth + 1, Ray(hitPoint, refractOut));
-			return refractProportion * refractColor + (1.0f - refractProportion) * specularColor;
+		if (material.isTransparent) {
+			Eigen::Vector4f reflectColor = specularColor();
+
+			// ȫʱûߣ׷
+			const auto& [refractProportion, refractOut] = material.refract(normal, r);
+			if (refractProportion == 0.0f)
+				return reflectColor;
+			Eigen::Vector4f refractColor = color(depth + 1, spawnRay(r, *hit, refractOut, ScatterType::Refract), sampler);
+			return refractProportion * refractColor + (1.0f - refractProportion) * reflectColor;
 		}
 		else {
-			const auto& specularOutRay = tri.specular(normal, r, specualrRayNum);
-			Eigen::Vector4f specularColor = Eigen::Vector4f::Zero();
-			for (int i = 0; i < specualrRayNum; ++i) {
-				specularColor += color(depth + 1, Ray(hitPoint, specularOutRay[i]));
-			}
-			specularColor *= (0.04f / static_cast<float>(specualrRayNum));
-
-			const auto& diffuseOutRay = tri.diffuse(normal, r, diffuseRayNum);
 			Eigen::Vector4f diffuseColor = Eigen::Vector4f::Zero();
 			for (int i = 0; i < diffuseRayNum; ++i) {
-				diffuseColor += color(depth + 1, Ray(hitPoint, diffuseOutRay[i]));
+				float u1 = sampler.next(), u2 = sampler.next();
+				const auto& sample = material.diffuse(normal, r, u1, u2);
+				diffuseColor += sample.weight.cwiseProduct(color(depth + 1, spawnRay(r, *hit, sample.direction, ScatterType::Diffuse), sampler));
 			}
-			diffuseColor = diffuseColor.cwiseProduct(tri.color) / static_cast<float>(diffuseRayNum);
+			diffuseColor /= static_cast<float>(diffuseRayNum);
+
+			// ֻӰɫ
+			if (material.textureIndex >= 0)
+				diffuseColor = diffuseColor.cwiseProduct(sampleTexture(*hit));
+
+			return specularColor() + diffuseColor;
+		}
+	}
+}
+
+// ӵڼηʼ˹̶
+constexpr int rouletteDepth = 3;
+
+// ҪԲpower heuristic
+static float powerHeuristic(float pdf, float otherPdf) {
+	float square = pdf * pdf;
+	return square / (square + otherPdf * otherPdf);
+}
+
+Eigen::Vector4f RayTracer::pathColor(const Ray& cameraRay, Sampler& sampler) const {
+	// ݹ鷽ʽʹͬĹƣֻÿηȨѡһ
+	// ·ۻȨسѡĸʣݹ鷽ʽͬ
+	Eigen::Vector4f result = Eigen::Vector4f::Zero();
+	Eigen::Vector4f throughput = Eigen::Vector4f::Constant(1.0f);
+	Ray r = cameraRay;
+	bool sampleLight = lightSampling && lights.hasLight();
+
+	// һηΪʱߵĸܶȣΪ0
+	float lastDiffusePdf = 0.0f;
+	for (int depth = 0; ; ++depth) {
+		sampler.startBounce(depth);
+		const auto& hit = intersect(r);
+		if (!hit) {
+			result += throughput.cwiseProduct(background(r));
+			break;
+		}
+
+		const auto& material = *hit->material;
+		const auto& normal = hit->normal;
+
+		// ignore rays coming from the back side
+		float cosine = normal.dot(r.direction);
+		if (depth == maxRecursionDepth || (!material.isTransparent && cosine >= 0.0f))
+			break;
 
-			Eigen::Vector4f outColor = specularColor + diffuseColor * fabsf(normal.dot(r.direction));
+		if (material.isLightEmitting) {
+			float weight = 1.0f;
+			if (sampleLight && lastDiffusePdf > 0.0f) {
+				// ߻йԴԴһ𰴸ܶȷȨ
+				Eigen::Vector4f toLight = hit->hitPoint - r.origin;
+				float squareDistance = toLight.squaredNorm();
+				float lightCosine = fabsf(cosine) / r.direction.norm();
+				weight = lightCosine > 0.0f ?
+					powerHeuristic(lastDiffusePdf, lights.areaPdf() * squareDistance / lightCosine) : 0.0f;
+			}
+			result += weight * throughput.cwiseProduct(material.color);
+			break;
+		}
 
-			if (tri.textureIndex < 0)
-				return outColor;
+		lastDiffusePdf = 0.0f;
+		Eigen::Vector4f direction;
+		ScatterType scatterType = ScatterType::Reflect;
+		if (material.isMetal) {
+			float u1 = sampler.next(), u2 = sampler.next();
+			const auto& sample = material.specular(normal, r, u1, u2);
+			direction = sample.direction;
+			throughput = throughput.cwiseProduct(sample.weight);
+		}
+		else if (material.isTransparent) {
+			// ͷѡһȨ
+			const auto& [refractProportion, refractOut] = material.refract(normal, r);
+			if (sampler.next() < refractProportion) {
+				direction = refractOut;
+				scatterType = ScatterType::Refract;
+			}
 			else {
-				Eigen::Vector2f uvCoordinate = alpha * tri.uvCoordinate(0) + beta * tri.uvCoordinate(1) +
-					(1.0f - (alpha + beta)) * tri.uvCoordinate(2);
+				float u1 = sampler.next(), u2 = sampler.next();
+				const auto& sample = material.specular(normal, r, u1, u2);
+				direction = sample.direction;
+				throughput = throughput.cwiseProduct(sample.weight);
+			}
+		}
+		else {
+			// BSDF * cos / pdf
+			Eigen::Vector4f diffuseWeight = material.color;
+			if (material.textureIndex >= 0)
+				diffuseWeight = diffuseWeight.cwiseProduct(sampleTexture(*hit));
+
+			// 䲿ֱӲԴԴһηű룬Ҫһδ
+			if (sampleLight && depth + 1 < maxRecursionDepth) {
+				float u0 = sampler.next(), u1 = sampler.next(), u2 = sampler.next();
+				const auto& light = lights.sample(u0, u1, u2);
+				Eigen::Vector4f toLight = light.position - hit->hitPoint;
+				float squareDistance = toLight.squaredNorm();
+				float distance = sqrtf(squareDistance);
+				toLight /= distance;
+
+				// Դֻ淢⣬Ӱ˸ͬľԾ
+				float lightCosine = -light.normal.dot(toLight);
+				float diffusePdf = material.diffusePdf(normal, r, toLight);
+				if (lightCosine > 0.0f && diffusePdf > 0.0f &&
+					!bvh.occluded(Ray(hit->hitPoint, toLight), distance - rayEpsilon)) {
+					float lightPdf = lights.areaPdf() * squareDistance / lightCosine;
+
+					// ĹΪ diffuseWeight * ⣬ɹԴ߸֮ܶ
+					float weight = powerHeuristic(lightPdf, diffusePdf) * diffusePdf / lightPdf;
+					result += weight * throughput.cwiseProduct(diffuseWeight).cwiseProduct(light.emission);
+				}
+			}
 
-				return outColor.cwiseProduct(texturesArray[tri.textureIndex].sampleTexture(uvCoordinate));
+			// ַʵıѡ淴䣬ǽľ淴ԼΪ0.04
+			float specularProbability = 0.04f / (0.04f + diffuseWeight.maxCoeff());
+			if (sampler.next() < specularProbability) {
+				float u1 = sampler.next(), u2 = sampler.next();
+				const auto& sample = material.specular(normal, r, u1, u2);
+				direction = sample.direction;
+				throughput = throughput.cwiseProduct(sample.weight) / specularProbability;
+			}
+			else {
+				float u1 = sampler.next(), u2 = sampler.next();
+				const auto& sample = material.diffuse(normal, r, u1, u2);
+				direction = sample.direction;
+				throughput = throughput.cwiseProduct(diffuseWeight) / (1.0f - specularProbability);
+				lastDiffusePdf = sample.pdf;
+				scatterType = ScatterType::Diffuse;
 			}
 		}
+
+		// ʱȨΪ0·ټ
+		if (throughput.head<3>().maxCoeff() <= 0.0f)
+			break;
+
+		// ȨؽС·ǰ·Ȩ
+		if (depth >= rouletteDepth) {
+			float survive = std::min(0.95f, throughput.head<3>().maxCoeff());
+			if (sampler.next() >= survive)
+				break;
+			throughput /= survive;
+		}
+
+		r = spawnRay(r, *hit, direction, scatterType);
+	}
+	return result;
+}
+
+// xyĸλ
+static uint32_t mortonCode(uint32_t x, uint32_t y) {
+	auto spread = [](uint32_t v) {
+		v &= 0x0000FFFFu;
+		v = (v | (v << 8)) & 0x00FF00FFu;
+		v = (v | (v << 4)) & 0x0F0F0F0Fu;
+		v = (v | (v << 2)) & 0x33333333u;
+		v = (v | (v << 1)) & 0x55555555u;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+void RayTracer::buildTiles() {
+	int tileNumX = (width + tileSize - 1) / tileSize;
+	int tileNumY = (height + tileSize - 1) / tileSize;
+	std::vector<std::pair<uint32_t, Tile>> ordered;
+	ordered.reserve(tileNumX * tileNumY);
+	for (int y = 0; y < tileNumY; ++y) {
+		for (int x = 0; x < tileNumX; ++x) {
+			Tile tile;
+			tile.x = x * tileSize;
+			tile.y = y * tileSize;
+			tile.width = std::min(tileSize, width - tile.x);
+			tile.height = std::min(tileSize, height - tile.y);
+			ordered.emplace_back(mortonCode(x, y), tile);
+		}
 	}
+
+	// ڵͼڿռҲڣBVHڵڻ
+	std::sort(ordered.begin(), ordered.end(),
+			  [](const auto& a, const auto& b) { return a.first < b.first; });
+	tiles.clear();
+	for (const auto& [code, tile] : ordered)
+		tiles.push_back(tile);
+	tileSeconds.assign(tiles.size(), 0.0f);
+}
+
+// Ӧʱۻô֡жǷ
+constexpr int minAdaptiveFrames = 4;
+// һֱΪڵؿֻǻûϡеļӹ·Ҫۻ֡
+constexpr int minBlackFrames = 64;
+// ÿô֡ԲһΣʹʱָ
+constexpr int adaptiveRecheckInterval = 16;
+
+bool RayTracer::converged(int row, int col) const {
+	int n = frameCount(row, col);
+	if (noiseThreshold <= 0.0f || n < minAdaptiveFrames)
+		return false;
+
+	// ÿ֡Ϊֵı׼ھֵ
+	float mean = accumulateImg(row, col).head<3>().mean() / n;
+	float variance = (accumulateSquare(row, col) / n - mean * mean) * n / (n - 1);
+	float error = sqrtf(std::max(variance, 0.0f) / n) / (mean + 0.01f);
+	if (accumulateSquare(row, col) <= 0.0f && n < minBlackFrames)
+		return false;
+	return error < noiseThreshold;
+}
+
+bool RayTracer::renderPixel(int row, int col, int frame) {
+	if (frame % adaptiveRecheckInterval != 0 && converged(row, col))
+		return false;
+
+	Eigen::Vector4f temp = Eigen::Vector4f::Zero();
+	for (int k = 0; k < 4; ++k) {
+		// ÿ֡ÿ4֮֡
+		Sampler sampler(samplerType, col, row, width, (frame - 1) * 4 + k);
+		float u = sampler.next();
+		float v = sampler.next();
+		const auto& ray = camera.getRay(col, row, u, v);
+		temp += integrator == Integrator::Path ? pathColor(ray, sampler) : color(0, ray, sampler);
+	}
+	temp *= 0.25f;
+	accumulateImg(row, col) += temp;
+	float luminance = temp.head<3>().mean();
+	accumulateSquare(row, col) += luminance * luminance;
+	frameCount(row, col)++;
+	return true;
+}
+
+// gammaУ[0, 1]ȷֳ65536ݣ㹻ְڵ8λֵ
+constexpr int gammaTableSize = 1 << 16;
+const std::array<uint8_t, gammaTableSize> gammaTable = []() {
+	std::array<uint8_t, gammaTableSize> temp;
+	for (int i = 0; i < gammaTableSize; ++i) {
+		float gammaCorrected = powf(i / static_cast<float>(gammaTableSize - 1), 1.0f / 2.2f);
+		temp[i] = static_cast<uint8_t>(std::min(lroundf(gammaCorrected * 255.0f), 255l));
+	}
+	return temp;
+}();
+
+void RayTracer::resolveOutput(bool ldr, bool hdr) {
+	if (hdr)
+		hdrBuffer.resize(width * height * 3);
+
+	tbb::parallel_for(0, height, [this, ldr, hdr](int row) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(gammaTableSize - 1);
+		alignas(16) float averaged[4];
+		alignas(16) int index[4];
+		for (int col = 0; col < width; ++col) {
+			// һδһص4
+			__m128 invCount = _mm_set1_ps(1.0f / std::max(frameCount(row, col), 1));
+			__m128 pixel = _mm_mul_ps(_mm_loadu_ps(accumulateImg(row, col).data()), invCount);
+			int offset = (row * width + col) * 3;
+
+			// Եĸͼֱۻƽõgamma
+			if (hdr) {
+				_mm_store_ps(averaged, pixel);
+				for (int k = 0; k < 3; ++k)
+					hdrBuffer[offset + k] = averaged[k];
+			}
+			if (ldr) {
+				__m128 clamped = _mm_min_ps(_mm_max_ps(pixel, zero), one);
+				_mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvtps_epi32(_mm_mul_ps(clamped, scale)));
+				for (int k = 0; k < 3; ++k)
+					outputBuffer[offset + k] = gammaTable[index[k]];
+			}
+		}
+	});
 }
 
 void RayTracer::render() {
+	auto renderStart = std::chrono::system_clock::now();
 	accumulateImg.resize(height, width);
 	accumulateImg.fill(Eigen::Vector4f::Zero());
+	accumulateSquare.resize(height, width);
+	accumulateSquare.fill(0.0f);
+	frameCount.resize(height, width);
+	frameCount.fill(0);
 	outputBuffer.resize(width * height * 3);
-	bvh.buildTree(trianglesArray);
-
-	for (int i = 1; i <= renderNum; ++i) {
+	bvh.buildTree(meshesArray, bvhBuilder, bvhWidth);
+	lights.build(meshesArray, materialsArray);
+	std::cout << "Build BVH with " << bvh.nodeNum() << " nodes, SAH cost " << bvh.sahCost()
+		<< ", use " << bvh.buildTime() << "s\n";
+	buildTiles();
+	if (textureCacheMB > 0)
+		textureCache = std::make_unique<TextureCache>(static_cast<size_t>(textureCacheMB) << 20,
+													  Texture::cacheTileBytes(textureOptions.storage));
+	for (auto& texture : texturesArray)
+		texture.prepare(textureOptions, textureCache.get());
+	skybox.prepare(textureOptions, textureCache.get());
+	std::cout << "Prepare " << texturesArray.size() << " unique textures\n";
+
+	// ʱԤʱ֡Ԥһ֡ᳬԤʱ
+	for (int i = 1; timeBudget > 0.0f || i <= renderNum; ++i) {
 		auto time1 = std::chrono::system_clock::now();
-		// RowMajorʽ洢п
-		tbb::parallel_for(0, height,
-						  [this, i](size_t row) {
-							  for (int col = 0; col < width; ++col) {
-								  const auto& ray = camera.getRay(col, row);
-
-								  Eigen::Vector4f temp = Eigen::Vector4f::Zero();
-								  for (const auto& r : ray) {
-									  temp += color(0, r);
-								  }
-								  accumulateImg(row, col) += temp * 0.25f;
-
-								  for (int k = 0; k < 3; ++k) {
-									  float averaged = accumulateImg(row, col)(k) / i;
-									  float gammaCorrected = powf(averaged, 1.0f / 2.2f);
-									  int clipNum = lroundf(gammaCorrected * 255.0f);
-									  if (clipNum > 255)
-										  clipNum = 255;
-									  if (clipNum < 0)
-										  clipNum = 0;
-
-									  outputBuffer[(row * width + col) * 3 + k] = clipNum;
+		// Morton˳ַͼ飬̴߳߳ȡδʼͼ
+		std::atomic<int> activePixels = 0;
+		tbb::parallel_for(tbb::blocked_range<int>(0, static_cast<int>(tiles.size()), 1),
+						  [this, i, &activePixels](const tbb::blocked_range<int>& range) {
+							  for (int index = range.begin(); index != range.end(); ++index) {
+								  auto tileTime1 = std::chrono::system_clock::now();
+								  const auto& tile = tiles[index];
+								  int tileActive = 0;
+								  for (int row = tile.y; row < tile.y + tile.height; ++row) {
+									  for (int col = tile.x; col < tile.x + tile.width; ++col) {
+										  if (renderPixel(row, col, i))
+											  tileActive++;
+									  }
 								  }
+								  activePixels += tileActive;
+								  auto tileTime2 = std::chrono::system_clock::now();
+								  tileSeconds[index] = std::chrono::duration<float>(tileTime2 - tileTime1).count();
 							  }
 						  });
 		auto time2 = std::chrono::system_clock::now();
+		float frameSeconds = std::chrono::duration<float>(time2 - time1).count();
+		float elapsedSeconds = std::chrono::duration<float>(time2 - renderStart).count();
+
+		bool allConverged = noiseThreshold > 0.0f && activePixels == 0;
+		bool outOfTime = timeBudget > 0.0f && elapsedSeconds + frameSeconds > timeBudget;
+		bool lastFrame = allConverged || outOfTime || (timeBudget <= 0.0f && i == renderNum);
+
+		// ʱԤʱֻһ֡򰴼
+		bool intervalFrame = timeBudget <= 0.0f && outputInterval > 0 && i % outputInterval == 0;
+		if (lastFrame || intervalFrame) {
+			std::stringstream str;
+			str << "out_";
+			str.fill('0');
+			str.width(3);
+			str << i;
+
+			// ֻۻֻҪ֡ϼƽֵgammaУ
+			resolveOutput(outputFormat != OutputFormat::PFM, outputFormat != OutputFormat::PNG);
+
+			// дļں̨Уһ֡Ⱦص
+			static const std::vector<uint8_t> noLdr;
+			static const std::vector<float> noHdr;
+			const auto& dropped = imageWriter.submit(str.str(),
+													 outputFormat != OutputFormat::PFM ? outputBuffer : noLdr,
+													 outputFormat != OutputFormat::PNG ? hdrBuffer : noHdr,
+													 width, height);
+			if (!dropped.empty())
+				std::cout << "Writer behind, skip " << dropped << "\n";
+
+			std::cout << "Output frame " << i << ", use " << frameSeconds << "s\n";
+		}
+		else
+			std::cout << "Render frame " << i << ", use " << frameSeconds << "s\n";
+
+		auto slowest = std::max_element(tileSeconds.begin(), tileSeconds.end()) - tileSeconds.begin();
+		float totalSeconds = 0.0f;
+		for (float seconds : tileSeconds)
+			totalSeconds += seconds;
+		std::cout << "Slowest tile at (" << tiles[slowest].x << ", " << tiles[slowest].y << ") use "
+			<< tileSeconds[slowest] << "s, average " << totalSeconds / tileSeconds.size() << "s\n";
+
+		if (noiseThreshold > 0.0f)
+			std::cout << "Sampled " << activePixels << " of " << width * height << " pixels\n";
+
+		if (textureCache) {
+			auto counters = textureCache->takeCounters();
+			std::cout << "Texture cache: " << counters.hits << " hits, " << counters.misses << " misses, "
+				<< counters.evictions << " evictions, " << counters.residentBytes / (1024.0f * 1024.0f) << "MB resident\n";
+		}
 
-		std::stringstream str;
-		str << "out_";
-		str.fill('0');
-		str.width(3);
-		str << i;
-		str << ".png";
-		stbi_write_png(str.str().c_str(), width, height, 3, outputBuffer.data(), 3 * width);
-
-		std::cout << "Output frame " << i << ", use " << std::chrono::duration<float>(time2 - time1).count() << "s\n";
+		if (allConverged) {
+			std::cout << "All pixels converged\n";
+			break;
+		}
+		if (outOfTime) {
+			std::cout << "Time budget used up, " << elapsedSeconds << "s of " << timeBudget << "s\n";
+			break;
+		}
+		if (lastFrame)
+			break;
 	}
+	imageWriter.finish();
 	std::cout << "Render finished" << std::endl;
 }
 
@@ -341,6 +850,115 @@ void RayTracer::parseConfigFile(std::string_view path) {
 			if (!skybox.hasSkybox())
 				std::cout << "Can't load skybox\n";
 		}
+		else if (key == "integrator") {
+			std::string name;
+			config >> name;
+			if (name == "recursive")
+				integrator = Integrator::Recursive;
+			else if (name == "path")
+				integrator = Integrator::Path;
+			else
+				throw std::exception("Expect: \"integrator\" is \"recursive\" or \"path\"");
+		}
+		else if (key == "light_sampling") {
+			config >> lightSampling;
+		}
+		else if (key == "sampler") {
+			std::string name;
+			config >> name;
+			if (name == "independent")
+				samplerType = SamplerType::Independent;
+			else if (name == "sobol")
+				samplerType = SamplerType::Sobol;
+			else if (name == "blue_noise")
+				samplerType = SamplerType::BlueNoise;
+			else
+				throw std::exception("Expect: \"sampler\" is \"independent\" or \"sobol\" or \"blue_noise\"");
+		}
+		else if (key == "time_budget") {
+			config >> timeBudget;
+			if (timeBudget < 0.0f)
+				throw std::exception("Expect: \"time_budget\" >= 0");
+		}
+		else if (key == "output_interval") {
+			config >> outputInterval;
+			if (outputInterval < 0)
+				throw std::exception("Expect: \"output_interval\" >= 0");
+		}
+		else if (key == "output_format") {
+			std::string format;
+			config >> format;
+			if (format == "png")
+				outputFormat = OutputFormat::PNG;
+			else if (format == "pfm")
+				outputFormat = OutputFormat::PFM;
+			else if (format == "both")
+				outputFormat = OutputFormat::Both;
+			else
+				throw std::exception("Expect: \"output_format\" is \"png\" or \"pfm\" or \"both\"");
+		}
+		else if (key == "texture_filter") {
+			std::string name;
+			config >> name;
+			if (name == "nearest")
+				textureOptions.filter = TextureFilter::Nearest;
+			else if (name == "bilinear")
+				textureOptions.filter = TextureFilter::Bilinear;
+			else if (name == "trilinear")
+				textureOptions.filter = TextureFilter::Trilinear;
+			else
+				throw std::exception("Expect: \"texture_filter\" is \"nearest\" or \"bilinear\" or \"trilinear\"");
+		}
+		else if (key == "texture_storage") {
+			std::string name;
+			config >> name;
+			if (name == "float")
+				textureOptions.storage = TextureStorage::Float;
+			else if (name == "byte")
+				textureOptions.storage = TextureStorage::Byte;
+			else
+				throw std::exception("Expect: \"texture_storage\" is \"float\" or \"byte\"");
+		}
+		else if (key == "texture_layout") {
+			std::string name;
+			config >> name;
+			if (name == "linear")
+				textureOptions.layout = TextureLayout::Linear;
+			else if (name == "tiled")
+				textureOptions.layout = TextureLayout::Tiled;
+			else
+				throw std::exception("Expect: \"texture_layout\" is \"linear\" or \"tiled\"");
+		}
+		else if (key == "texture_cache_mb") {
+			config >> textureCacheMB;
+			if (textureCacheMB < 0)
+				throw std::exception("Expect: \"texture_cache_mb\" >= 0");
+		}
+		else if (key == "noise_threshold") {
+			config >> noiseThreshold;
+			if (noiseThreshold < 0.0f)
+				throw std::exception("Expect: \"noise_threshold\" >= 0");
+		}
+		else if (key == "tile_size") {
+			config >> tileSize;
+			if (tileSize <= 0)
+				throw std::exception("Expect: \"tile_size\" > 0");
+		}
+		else if (key == "bvh_builder") {
+			std::string builder;
+			config >> builder;
+			if (builder == "sah")
+				bvhBuilder = BVHBuilder::SAH;
+			else if (builder == "median")
+				bvhBuilder = BVHBuilder::Median;
+			else
+				throw std::exception("Expect: \"bvh_builder\" is \"sah\" or \"median\"");
+		}
+		else if (key == "bvh_width") {
+			config >> bvhWidth;
+			if (bvhWidth != 4 && bvhWidth != 8)
+				throw std::exception("Expect: \"bvh_width\" is 4 or 8");
+		}
 		else if (key == "model_start") {
 			std::string modelPath;
 			if (config >> key && key == "model_path")
@@ -510,7 +1128,7 @@ void RayTracer::parseConfigFile(std::string_view path) {
 			break;
 		}
 		else
-			throw std::exception("Expect: \"skybox\" or \"model_start\" or \"triangle_start\" or \"render_num\"");
+			throw std::exception("Expect: \"skybox\" or \"integrator\" or \"light_sampling\" or \"sampler\" or \"time_budget\" or \"output_interval\" or \"output_format\" or \"texture_filter\" or \"texture_storage\" or \"texture_layout\" or \"texture_cache_mb\" or \"noise_threshold\" or \"tile_size\" or \"bvh_builder\" or \"bvh_width\" or \"model_start\" or \"triangle_start\" or \"render_num\"");
 	}
 
 	config.close();
@@ -0,0 +1,131 @@
+#include <RayTracer/Sampler.h>
+#include <array>
+#include <cmath>
+
+constexpr int blueNoiseSize = 64;
+constexpr int blueNoiseMask = blueNoiseSize - 1;
+
+// void-and-cluster͵Ŀλ˳Ϊȡֵ
+// refer to: The void-and-cluster method for dither array generation (Ulichney 1993)
+const std::array<float, blueNoiseSize * blueNoiseSize> blueNoise = []() {
+	constexpr int pixelNum = blueNoiseSize * blueNoiseSize;
+	constexpr int radius = 6;
+	constexpr float sigma = 1.9f;
+
+	std::array<float, (2 * radius + 1) * (2 * radius + 1)> kernel;
+	for (int dy = -radius; dy <= radius; ++dy) {
+		for (int dx = -radius; dx <= radius; ++dx) {
+			kernel[(dy + radius) * (2 * radius + 1) + dx + radius] = expf(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+		}
+	}
+
+	std::array<float, pixelNum> energy;
+	std::array<bool, pixelNum> filled;
+	std::array<float, pixelNum> temp;
+	energy.fill(0.0f);
+	filled.fill(false);
+	for (int rank = 0; rank < pixelNum; ++rank) {
+		int best = -1;
+		for (int i = 0; i < pixelNum; ++i) {
+			if (!filled[i] && (best == -1 || energy[i] < energy[best]))
+				best = i;
+		}
+		filled[best] = true;
+		temp[best] = (rank + 0.5f) / pixelNum;
+
+		// 
+		int bestX = best & blueNoiseMask;
+		int bestY = best / blueNoiseSize;
+		for (int dy = -radius; dy <= radius; ++dy) {
+			for (int dx = -radius; dx <= radius; ++dx) {
+				int index = ((bestY + dy) & blueNoiseMask) * blueNoiseSize + ((bestX + dx) & blueNoiseMask);
+				energy[index] += kernel[(dy + radius) * (2 * radius + 1) + dx + radius];
+			}
+		}
+	}
+	return temp;
+}();
+
+static uint32_t reverseBits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// ɢеOwen
+// refer to: Practical Hash-based Owen Scrambling (Burley 2020)
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+// SobolеĵڶάһάΪλת
+static uint32_t sobolSecond(uint32_t index) {
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+		if (index & 1u)
+			result ^= v;
+	}
+	return result;
+}
+
+static float toFloat(uint32_t x) {
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+Sampler::Sampler(SamplerType type, int x, int y, int width, uint32_t sampleIndex) :
+	type(type), x(x), y(y), sampleIndex(sampleIndex),
+	pixelSeed(Random::hash(static_cast<uint32_t>(y * width + x))),
+	bounce(0xFFFFFFFFu), dimension(0), pairSecond(0.0f),
+	random(static_cast<uint32_t>(y * width + x), sampleIndex) { }
+
+void Sampler::startBounce(uint32_t bounce) {
+	this->bounce = bounce;
+	dimension = 0;
+	random.startBounce(bounce);
+}
+
+float Sampler::next() {
+	if (type == SamplerType::Independent)
+		return random.next();
+
+	uint32_t current = dimension++;
+	if (current & 1u)
+		return pairSecond;
+	return sobolPair(current >> 1);
+}
+
+// ߵάɶάSobolƴӶɣÿòͬӴ˳򣬱
+float Sampler::sobolPair(uint32_t pairIndex) {
+	uint32_t pairSeed = Random::hash(Random::hash(bounce) + pairIndex);
+	uint32_t seed = type == SamplerType::Sobol ? Random::hash(pixelSeed ^ pairSeed) : pairSeed;
+
+	uint32_t index = nestedUniformScramble(sampleIndex, seed);
+	uint32_t seed0 = Random::hash(seed + 1u);
+	uint32_t seed1 = Random::hash(seed + 2u);
+	float first = toFloat(nestedUniformScramble(reverseBits(index), seed0));
+	float second = toFloat(nestedUniformScramble(sobolSecond(index), seed1));
+
+	if (type == SamplerType::BlueNoise) {
+		// ÿһάͬƫƶȡƽƺȡС
+		auto shift = [this](uint32_t seed) {
+			int offsetX = static_cast<int>(seed & blueNoiseMask);
+			int offsetY = static_cast<int>((seed >> 8) & blueNoiseMask);
+			return blueNoise[((y + offsetY) & blueNoiseMask) * blueNoiseSize + ((x + offsetX) & blueNoiseMask)];
+		};
+		first += shift(seed0);
+		second += shift(seed1);
+		first -= first >= 1.0f ? 1.0f : 0.0f;
+		second -= second >= 1.0f ? 1.0f : 0.0f;
+	}
+
+	pairSecond = second;
+	return first;
+}
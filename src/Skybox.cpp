@@ -29,6 +29,11 @@ bool Skybox::hasSkybox() const {
 	return !backgroundImg.empty();
 }
 
+void Skybox::prepare(const TextureOptions& options, TextureCache* cache) {
+	for (auto& texture : backgroundImg)
+		texture.prepare(options, cache);
+}
+
 Eigen::Vector4f Skybox::sampleBackground(const Ray& ray) const {
 	Eigen::Vector4f projection;
 	float divisor, u, v;
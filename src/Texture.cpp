@@ -1,53 +1,282 @@
 #include <RayTracer/Texture.h>
+#include <RayTracer/TextureCache.h>
 #include <stb_image.h>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <array>
 
-Texture::Texture(std::string_view path) {
-	int height, channels;
+// sRGBԿռת
+const std::array<float, 256> linearTable = []() {
+	std::array<float, 256> temp;
+	for (int i = 0; i < 256; ++i) {
+		temp[i] = powf(i / 255.0f, 2.2f);
+	}
+	return temp;
+}();
+
+Texture::Texture(std::string_view path) : path(path) {
+	int width, height, channels;
+	valid = stbi_info(this->path.c_str(), &width, &height, &channels) != 0;
+}
+
+bool Texture::hasTexture() const {
+	return valid;
+}
+
+const std::string& Texture::filePath() const {
+	return path;
+}
+
+// ֿʱı߳
+constexpr int tileShift = 3;
+constexpr int tileSize = 1 << tileShift;
+constexpr int tileMask = tileSize - 1;
+
+// ʹûʱı߳
+constexpr int cacheTileShift = 6;
+constexpr int cacheTileSize = 1 << cacheTileShift;
+constexpr int cacheTileMask = cacheTileSize - 1;
+
+// еתΪֿУ߳һĲֲ0
+template <typename T>
+static std::vector<T> toTiled(const std::vector<T>& data, int width, int height, int tileNumX) {
+	int tileNumY = (height + tileMask) >> tileShift;
+	std::vector<T> result(tileNumX * tileNumY * tileSize * tileSize * 3, T(0));
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int tile = (y >> tileShift) * tileNumX + (x >> tileShift);
+			int offset = ((tile << (2 * tileShift)) + ((y & tileMask) << tileShift) + (x & tileMask)) * 3;
+			for (int k = 0; k < 3; ++k)
+				result[offset + k] = data[(y * width + x) * 3 + k];
+		}
+	}
+	return result;
+}
+
+// 8λݲתԿռ䣬ѾԵ
+static float toLinear(uint8_t value) {
+	return linearTable[value];
+}
+
+static float toLinear(float value) {
+	return value;
+}
+
+// һԿռ2x2ƽõһ㣬߳ʱһлһǰһظ
+template <typename T>
+static std::vector<float> downsample(const std::vector<T>& upper, int upperWidth, int upperHeight, int width, int height) {
+	std::vector<float> result(width * height * 3);
+	for (int y = 0; y < height; ++y) {
+		int y0 = std::min(y * 2, upperHeight - 1);
+		int y1 = std::min(y * 2 + 1, upperHeight - 1);
+		for (int x = 0; x < width; ++x) {
+			int x0 = std::min(x * 2, upperWidth - 1);
+			int x1 = std::min(x * 2 + 1, upperWidth - 1);
+			for (int k = 0; k < 3; ++k) {
+				float sum = toLinear(upper[(y0 * upperWidth + x0) * 3 + k]) + toLinear(upper[(y0 * upperWidth + x1) * 3 + k]) +
+					toLinear(upper[(y1 * upperWidth + x0) * 3 + k]) + toLinear(upper[(y1 * upperWidth + x1) * 3 + k]);
+				result[(y * width + x) * 3 + k] = sum * 0.25f;
+			}
+		}
+	}
+	return result;
+}
+
+void Texture::prepare(const TextureOptions& options, TextureCache* cache) {
+	this->options = options;
+	auto filter = options.filter;
+	auto storage = options.storage;
+
+	int width, height, channels;
 	stbi_set_flip_vertically_on_load(1);
-	data = stbi_load(path.data(), &width, &height, &channels, 3);
+	uint8_t* data = stbi_load(path.c_str(), &width, &height, &channels, 3);
 	if (data == nullptr)
-		return;
+		throw std::exception("Can't load texture");
+
+	// ԭͼ8λ洢ʱݣ洢ʱתԿռ
+	levels.assign(1, MipLevel());
+	auto& base = levels[0];
+	base.width = width;
+	base.height = height;
+	if (storage == TextureStorage::Float) {
+		base.floats.resize(width * height * 3);
+		std::transform(data, data + width * height * 3, base.floats.begin(),
+					   [](uint8_t value) { return linearTable[value]; });
+	}
+	else
+		base.bytes.assign(data, data + width * height * 3);
+	stbi_image_free(data);
 
-	uMaxIndex = static_cast<float>(width - 1);
-	vMaxIndex = static_cast<float>(height - 1);
+	// ʹûʱ׷ӵͬһļ
+	this->cache = cache;
+	uint32_t tileCount = 0;
+	if (cache != nullptr)
+		cacheFile = cache->create();
+
+	// һһתΪյĸʽ8λ洢ʱֵתsRGBͬʱֻĸ
+	auto finishLevel = [&](MipLevel& level) {
+		if (storage == TextureStorage::Byte && !level.floats.empty()) {
+			level.bytes.resize(level.floats.size());
+			std::transform(level.floats.begin(), level.floats.end(), level.bytes.begin(),
+						   [](float value) { return static_cast<uint8_t>(lroundf(powf(value, 1.0f / 2.2f) * 255.0f)); });
+			std::vector<float>().swap(level.floats);
+		}
+
+		if (cache != nullptr) {
+			level.tileBase = tileCount;
+			tileCount += spillLevel(level);
+			return;
+		}
+
+		level.tileNumX = (level.width + tileMask) >> tileShift;
+		if (options.layout == TextureLayout::Tiled) {
+			if (storage == TextureStorage::Float)
+				level.floats = toTiled(level.floats, level.width, level.height, level.tileNumX);
+			else
+				level.bytes = toTiled(level.bytes, level.width, level.height, level.tileNumX);
+		}
+	};
+
+	while (filter != TextureFilter::Nearest && (levels.back().width > 1 || levels.back().height > 1)) {
+		auto& upper = levels.back();
+		MipLevel level;
+		level.width = std::max(upper.width / 2, 1);
+		level.height = std::max(upper.height / 2, 1);
+		if (upper.floats.empty())
+			level.floats = downsample(upper.bytes, upper.width, upper.height, level.width, level.height);
+		else
+			level.floats = downsample(upper.floats, upper.width, upper.height, level.width, level.height);
+		finishLevel(upper);
+		levels.push_back(std::move(level));
+	}
+	finishLevel(levels.back());
 }
 
-Texture::~Texture() {
-	if (data != nullptr)
-		stbi_image_free(data);
+uint32_t Texture::spillLevel(MipLevel& level) const {
+	size_t elementSize = options.storage == TextureStorage::Float ? sizeof(float) : sizeof(uint8_t);
+	size_t tileBytes = cacheTileBytes(options.storage);
+	const uint8_t* source = options.storage == TextureStorage::Float ?
+		reinterpret_cast<const uint8_t*>(level.floats.data()) : level.bytes.data();
+	level.tileNumX = (level.width + cacheTileMask) >> cacheTileShift;
+	int tileNumY = (level.height + cacheTileMask) >> cacheTileShift;
+
+	// ÿֻڴ֯һп飬ڰУͼĲֲ0
+	std::vector<uint8_t> tiles(level.tileNumX * tileBytes);
+	for (int tileY = 0; tileY < tileNumY; ++tileY) {
+		std::fill(tiles.begin(), tiles.end(), uint8_t(0));
+		int yEnd = std::min((tileY + 1) << cacheTileShift, level.height);
+		for (int y = tileY << cacheTileShift; y < yEnd; ++y) {
+			for (int x = 0; x < level.width; ++x) {
+				size_t offset = (x >> cacheTileShift) * tileBytes +
+					(((y & cacheTileMask) << cacheTileShift) + (x & cacheTileMask)) * 3 * elementSize;
+				std::memcpy(tiles.data() + offset, source + (static_cast<size_t>(y) * level.width + x) * 3 * elementSize, 3 * elementSize);
+			}
+		}
+		cache->append(cacheFile, tiles);
+	}
+
+	std::vector<uint8_t>().swap(level.bytes);
+	std::vector<float>().swap(level.floats);
+	return level.tileNumX * tileNumY;
 }
 
-Texture::Texture(Texture&& rhs) noexcept {
-	this->data = rhs.data;
-	rhs.data = nullptr;
-	this->uMaxIndex = rhs.uMaxIndex;
-	this->vMaxIndex = rhs.vMaxIndex;
-	this->width = rhs.width;
+size_t Texture::cacheTileBytes(TextureStorage storage) {
+	size_t elementSize = storage == TextureStorage::Float ? sizeof(float) : sizeof(uint8_t);
+	return cacheTileSize * cacheTileSize * 3 * elementSize;
 }
 
-Texture& Texture::operator=(Texture&& rhs) noexcept {
-	this->data = rhs.data;
-	rhs.data = nullptr;
-	this->uMaxIndex = rhs.uMaxIndex;
-	this->vMaxIndex = rhs.vMaxIndex;
-	this->width = rhs.width;
-	return *this;
+int Texture::texelOffset(const MipLevel& level, int x, int y) const {
+	if (options.layout == TextureLayout::Linear)
+		return (y * level.width + x) * 3;
+
+	int tile = (y >> tileShift) * level.tileNumX + (x >> tileShift);
+	return ((tile << (2 * tileShift)) + ((y & tileMask) << tileShift) + (x & tileMask)) * 3;
 }
 
-bool Texture::hasTexture() const {
-	return data != nullptr;
+Eigen::Vector4f Texture::texel(const MipLevel& level, int x, int y, TileRef& tile) const {
+	if (cache != nullptr) {
+		// пãڼ䱻̭Ҳͷţֻпʱٲһ
+		uint32_t tileIndex = level.tileBase + (y >> cacheTileShift) * level.tileNumX + (x >> cacheTileShift);
+		if (tile.index != tileIndex) {
+			tile.data = cache->tile(cacheFile, tileIndex);
+			tile.index = tileIndex;
+		}
+		int offset = (((y & cacheTileMask) << cacheTileShift) + (x & cacheTileMask)) * 3;
+		if (options.storage == TextureStorage::Float) {
+			float color[3];
+			std::memcpy(color, tile.data->data() + offset * sizeof(float), sizeof(color));
+			return Eigen::Vector4f(color[0], color[1], color[2], 0.0f);
+		}
+		const uint8_t* color = tile.data->data() + offset;
+		return Eigen::Vector4f(linearTable[color[0]], linearTable[color[1]], linearTable[color[2]], 0.0f);
+	}
+
+	int offset = texelOffset(level, x, y);
+	if (options.storage == TextureStorage::Float) {
+		const float* color = level.floats.data() + offset;
+		return Eigen::Vector4f(color[0], color[1], color[2], 0.0f);
+	}
+	else {
+		const uint8_t* color = level.bytes.data() + offset;
+		return Eigen::Vector4f(linearTable[color[0]], linearTable[color[1]], linearTable[color[2]], 0.0f);
+	}
+}
+
+Eigen::Vector4f Texture::nearest(const Eigen::Vector2f& uvCoordinate) const {
+	const auto& level = levels[0];
+	int x = std::clamp(static_cast<int>(uvCoordinate(0) * level.width), 0, level.width - 1);
+	int y = std::clamp(static_cast<int>(uvCoordinate(1) * level.height), 0, level.height - 1);
+	TileRef tile;
+	return texel(level, x, y, tile);
+}
+
+Eigen::Vector4f Texture::bilinear(int levelIndex, const Eigen::Vector2f& uvCoordinate) const {
+	const auto& level = levels[levelIndex];
+
+	// (i + 0.5) / widthΧʱȡԵ
+	float x = uvCoordinate(0) * level.width - 0.5f;
+	float y = uvCoordinate(1) * level.height - 0.5f;
+	float floorX = floorf(x);
+	float floorY = floorf(y);
+	float fracX = x - floorX;
+	float fracY = y - floorY;
+	int x0 = std::clamp(static_cast<int>(floorX), 0, level.width - 1);
+	int y0 = std::clamp(static_cast<int>(floorY), 0, level.height - 1);
+	int x1 = std::clamp(static_cast<int>(floorX) + 1, 0, level.width - 1);
+	int y1 = std::clamp(static_cast<int>(floorY) + 1, 0, level.height - 1);
+
+	// 2x2شͬһڣ˳ȡʱֻڿʱһ
+	TileRef tile;
+	Eigen::Vector4f top = (1.0f - fracX) * texel(level, x0, y0, tile) + fracX * texel(level, x1, y0, tile);
+	Eigen::Vector4f bottom = (1.0f - fracX) * texel(level, x0, y1, tile) + fracX * texel(level, x1, y1, tile);
+	return (1.0f - fracY) * top + fracY * bottom;
 }
 
 Eigen::Vector4f Texture::sampleTexture(const Eigen::Vector2f& uvCoordinate) const {
-	float u = uvCoordinate(0);
-	float v = uvCoordinate(1);
-	// try nearest-neighbor
-	int sampleX = lroundf(u * uMaxIndex);
-	int sampleY = lroundf(v * vMaxIndex);
-	uint8_t* color = data + (sampleY * width + sampleX) * 3;
-	// ӳ䵽[0, 1]תGammaΪLinear
-	float r = std::powf(color[0] / 255.0f, 2.2f);
-	float g = std::powf(color[1] / 255.0f, 2.2f);
-	float b = std::powf(color[2] / 255.0f, 2.2f);
-	return Eigen::Vector4f(r, g, b, 0.0f);
+	if (options.filter == TextureFilter::Nearest)
+		return nearest(uvCoordinate);
+	return bilinear(0, uvCoordinate);
+}
+
+Eigen::Vector4f Texture::sampleTexture(const Eigen::Vector2f& uvCoordinate,
+									   const Eigen::Vector2f& uvDx, const Eigen::Vector2f& uvDy) const {
+	if (options.filter == TextureFilter::Nearest)
+		return nearest(uvCoordinate);
+
+	// Χڵ0ϸǵȡϳһ
+	const auto& base = levels[0];
+	Eigen::Vector2f size(static_cast<float>(base.width), static_cast<float>(base.height));
+	float footprint = std::max(uvDx.cwiseProduct(size).norm(), uvDy.cwiseProduct(size).norm());
+	float lod = std::clamp(log2f(std::max(footprint, 1.0f)), 0.0f, static_cast<float>(levels.size() - 1));
+
+	if (options.filter == TextureFilter::Bilinear)
+		return bilinear(static_cast<int>(lod + 0.5f), uvCoordinate);
+
+	int lower = static_cast<int>(lod);
+	int upper = std::min(lower + 1, static_cast<int>(levels.size()) - 1);
+	float fraction = lod - lower;
+	if (fraction == 0.0f)
+		return bilinear(lower, uvCoordinate);
+	return (1.0f - fraction) * bilinear(lower, uvCoordinate) + fraction * bilinear(upper, uvCoordinate);
 }
\ No newline at end of file
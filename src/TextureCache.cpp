@@ -0,0 +1,176 @@
+#include <RayTracer/TextureCache.h>
+#include <RayTracer/Random.h>
+#include <filesystem>
+#include <exception>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+// ͬ򿪵ļϵͳڲжд첽ʽ򿪣ÿζдԼ¼ȴ
+static OVERLAPPED startOverlapped(uint64_t offset) {
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	return overlapped;
+}
+
+static size_t finishOverlapped(HANDLE handle, OVERLAPPED& overlapped, BOOL started) {
+	DWORD transferred = 0;
+	if (started || GetLastError() == ERROR_IO_PENDING)
+		started = GetOverlappedResult(handle, &overlapped, &transferred, TRUE);
+	CloseHandle(overlapped.hEvent);
+	return started ? transferred : 0;
+}
+#endif
+
+// offsetдsizeֽڣʵʶдֽʧʱ0
+static size_t writeAt(intptr_t handle, const uint8_t* data, size_t size, uint64_t offset) {
+#ifdef _WIN32
+	auto overlapped = startOverlapped(offset);
+	BOOL started = WriteFile(reinterpret_cast<HANDLE>(handle), data, static_cast<DWORD>(size), nullptr, &overlapped);
+	return finishOverlapped(reinterpret_cast<HANDLE>(handle), overlapped, started);
+#else
+	ssize_t written = pwrite(static_cast<int>(handle), data, size, static_cast<off_t>(offset));
+	return written < 0 ? 0 : static_cast<size_t>(written);
+#endif
+}
+
+static size_t readAt(intptr_t handle, uint8_t* data, size_t size, uint64_t offset) {
+#ifdef _WIN32
+	auto overlapped = startOverlapped(offset);
+	BOOL started = ReadFile(reinterpret_cast<HANDLE>(handle), data, static_cast<DWORD>(size), nullptr, &overlapped);
+	return finishOverlapped(reinterpret_cast<HANDLE>(handle), overlapped, started);
+#else
+	ssize_t read = pread(static_cast<int>(handle), data, size, static_cast<off_t>(offset));
+	return read < 0 ? 0 : static_cast<size_t>(read);
+#endif
+}
+
+TextureCache::TextureCache(size_t budgetBytes, size_t tileBytes) :
+	tileBytes(tileBytes), shards(std::clamp<size_t>(budgetBytes / tileBytes, 1, maxShardNum)) {
+	if (budgetBytes < tileBytes)
+		throw std::exception("Texture cache budget is smaller than one tile");
+	shardBudget = budgetBytes / shards.size();
+}
+
+TextureCache::~TextureCache() {
+	for (auto& file : files) {
+#ifdef _WIN32
+		CloseHandle(reinterpret_cast<HANDLE>(file.handle));
+#else
+		close(static_cast<int>(file.handle));
+#endif
+	}
+}
+
+int TextureCache::create() {
+	int index = static_cast<int>(files.size());
+	auto directory = std::filesystem::temp_directory_path();
+
+	File file;
+	file.size = 0;
+#ifdef _WIN32
+	// ְ̺ţѴʱһԣḲ̵ļ
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	for (int attempt = 0; attempt < 100 && handle == INVALID_HANDLE_VALUE; ++attempt) {
+		auto path = directory / ("raytracer_texture_" + std::to_string(GetCurrentProcessId()) + "_" +
+								 std::to_string(reinterpret_cast<uintptr_t>(this)) + "_" + std::to_string(index) + "_" +
+								 std::to_string(attempt) + ".bin");
+		handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+							 CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_OVERLAPPED, nullptr);
+		if (handle == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS)
+			break;
+	}
+	if (handle == INVALID_HANDLE_VALUE)
+		throw std::exception("Can't create texture cache file");
+	file.handle = reinterpret_cast<intptr_t>(handle);
+#else
+	std::string path = (directory / "raytracer_texture_XXXXXX").string();
+	int handle = mkstemp(path.data());
+	if (handle < 0)
+		throw std::exception("Can't create texture cache file");
+	unlink(path.c_str());
+	file.handle = handle;
+#endif
+	files.push_back(file);
+	return index;
+}
+
+void TextureCache::append(int fileIndex, const std::vector<uint8_t>& tiles) {
+	auto& file = files[fileIndex];
+	if (writeAt(file.handle, tiles.data(), tiles.size(), file.size) != tiles.size())
+		throw std::exception("Can't write texture cache file");
+	file.size += tiles.size();
+}
+
+std::shared_ptr<const std::vector<uint8_t>> TextureCache::load(int fileIndex, uint32_t tileIndex) {
+	const auto& file = files[fileIndex];
+	auto data = std::make_shared<std::vector<uint8_t>>(tileBytes);
+	if (readAt(file.handle, data->data(), tileBytes, static_cast<uint64_t>(tileIndex) * tileBytes) != tileBytes)
+		throw std::exception("Can't read texture cache file");
+	return data;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> TextureCache::tile(int file, uint32_t tileIndex) {
+	uint64_t key = (static_cast<uint64_t>(file) << 32) | tileIndex;
+	auto& shard = shards[Random::hash(static_cast<uint32_t>(key ^ (key >> 32)) + tileIndex) % shards.size()];
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto iter = shard.entries.find(key);
+		if (iter != shard.entries.end()) {
+			shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.position);
+			hits++;
+			return iter->second.data;
+		}
+	}
+
+	// ļʱзƬ߳ͬʱȱʧͬһʱһʹе
+	misses++;
+	auto data = load(file, tileIndex);
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto iter = shard.entries.find(key);
+	if (iter != shard.entries.end()) {
+		shard.lru.splice(shard.lru.begin(), shard.lru, iter->second.position);
+		return iter->second.data;
+	}
+
+	shard.lru.push_front(key);
+	shard.entries.emplace(key, Entry{ data, shard.lru.begin() });
+	shard.bytes += data->size();
+	residentBytes += data->size();
+
+	// ʱδʹõһͷţնһ鱣
+	while (shard.bytes > shardBudget && shard.lru.size() > 1) {
+		uint64_t victim = shard.lru.back();
+		shard.lru.pop_back();
+		auto victimIter = shard.entries.find(victim);
+		size_t victimBytes = victimIter->second.data->size();
+		shard.entries.erase(victimIter);
+		shard.bytes -= victimBytes;
+		residentBytes -= victimBytes;
+		evictions++;
+	}
+	return data;
+}
+
+TextureCache::Counters TextureCache::takeCounters() {
+	Counters result;
+	result.hits = hits.exchange(0);
+	result.misses = misses.exchange(0);
+	result.evictions = evictions.exchange(0);
+	result.residentBytes = residentBytes;
+	return result;
+}
\ No newline at end of file
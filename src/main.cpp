@@ -1,7 +1,20 @@
 #include <RayTracer/RayTracer.h>
+#include <RayTracer/Benchmark.h>
 #include <iostream>
+#include <string_view>
 
 int main(int args, char** argv) {
+	// RayTracer --texture-benchmark image 
+	if (args == 3 && std::string_view(argv[1]) == "--texture-benchmark") {
+		try {
+			textureBenchmark(argv[2]);
+		}
+		catch (const std::exception& e) {
+			std::cout << e.what() << std::endl;
+		}
+		return 0;
+	}
+
 	if (args != 2) {
 		std::cout << "Invalid arguments\n";
 		return -1;